@@ -0,0 +1,75 @@
+// Nanoseconds per CPU and PPU bus access for each address region.
+// Run with --benchmark_format=json (or --benchmark_out=file.json) for machine-readable results;
+// real_time is the time per access.
+#include <benchmark/benchmark.h>
+
+#include "../src/bus.h"
+
+static void cpu_read(benchmark::State& state, uint16_t address) {
+    Bus* bus = new Bus();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bus->read_from_cpu(address));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete bus;
+}
+
+static void cpu_write(benchmark::State& state, uint16_t address) {
+    Bus* bus = new Bus();
+    uint8_t value = 0;
+
+    for (auto _ : state) {
+        bus->write_to_memory(address, value++);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete bus;
+}
+
+static void ppu_read(benchmark::State& state, uint16_t address) {
+    Bus* bus = new Bus();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bus->read_from_ppu(address));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete bus;
+}
+
+static void ppu_write(benchmark::State& state, uint16_t address) {
+    Bus* bus = new Bus();
+    uint8_t value = 0;
+
+    for (auto _ : state) {
+        // Changing values, rewriting the same one takes a shortcut
+        bus->write_to_ppu(address, value++);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete bus;
+}
+
+BENCHMARK_CAPTURE(cpu_read, ram, 0x0123);
+BENCHMARK_CAPTURE(cpu_read, ppu_register, 0x2002);
+BENCHMARK_CAPTURE(cpu_read, ppu_register_mirror, 0x3FFA);
+BENCHMARK_CAPTURE(cpu_read, apu_status, 0x4015);
+BENCHMARK_CAPTURE(cpu_read, controller, 0x4016);
+BENCHMARK_CAPTURE(cpu_read, prg_rom, 0x8123);
+
+BENCHMARK_CAPTURE(cpu_write, ram, 0x0123);
+BENCHMARK_CAPTURE(cpu_write, ppu_scroll, 0x2005);
+BENCHMARK_CAPTURE(cpu_write, apu_register, 0x4002);
+BENCHMARK_CAPTURE(cpu_write, controller_strobe, 0x4016);
+
+BENCHMARK_CAPTURE(ppu_read, pattern_table, 0x0123);
+BENCHMARK_CAPTURE(ppu_read, name_table_mirror, 0x2C45);
+BENCHMARK_CAPTURE(ppu_read, palette_mirror, 0x3F10);
+
+BENCHMARK_CAPTURE(ppu_write, pattern_table, 0x0123);
+BENCHMARK_CAPTURE(ppu_write, name_table, 0x2045);
+BENCHMARK_CAPTURE(ppu_write, palette, 0x3F05);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,101 @@
+// Nanoseconds per instruction for each class of opcodes.
+// Run with --benchmark_format=json (or --benchmark_out=file.json) for machine-readable results;
+// real_time is the time per instruction.
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <string>
+
+#include "../src/bus.h"
+
+#define BLOCK_START LOWER_PRG_ROM_START
+#define BLOCK_SIZE 0x7000 // Straight-line code from $8000, well clear of the vectors
+
+static bool workload_failed = false;
+
+// Fills PRG-ROM with a prologue followed by the same instruction over and over and runs it
+// one instruction per iteration; the machine is rewound (untimed) when the block runs out.
+// expected_cycles holds what each instruction of the repeated sequence takes, the whole block is checked
+// against it first so a workload the CPU doesn't run as intended fails instead of timing something else
+static void run_block(benchmark::State& state, std::vector<uint8_t> prologue, std::vector<uint8_t> instruction, std::vector<uint8_t> expected_cycles) {
+    Bus* bus = new Bus();
+    MachineState* start = new MachineState();
+
+    std::vector<uint8_t> block = prologue;
+    while (block.size() + instruction.size() <= BLOCK_SIZE) {
+        block.insert(block.end(), instruction.begin(), instruction.end());
+    }
+    bus->write_array_to_memory(block.data(), BLOCK_START, block.size());
+
+    uint32_t instructions_per_block = (BLOCK_SIZE - prologue.size()) / instruction.size() - 1;
+
+    // Run the prologue so it isn't timed
+    for (size_t i = 0; i < prologue.size(); ) {
+        bus->execute_next_instruction();
+        i += 2;
+    }
+    bus->save_state(*start);
+
+    for (uint32_t i = 0; i < instructions_per_block; i++) {
+        uint8_t expected = expected_cycles[i % expected_cycles.size()];
+        uint8_t taken = bus->execute_next_instruction();
+
+        if (taken != expected) {
+            std::string error = "Instruction " + std::to_string(i) + " took " + std::to_string(taken) + " cycles instead of " + std::to_string(expected);
+            state.SkipWithError(error.c_str());
+            workload_failed = true;
+            delete start;
+            delete bus;
+            return;
+        }
+    }
+    bus->load_state(*start);
+
+    uint32_t executed = 0;
+    uint64_t cycles = 0;
+
+    for (auto _ : state) {
+        cycles += bus->execute_next_instruction();
+
+        if (++executed == instructions_per_block) {
+            state.PauseTiming();
+            bus->load_state(*start);
+            executed = 0;
+            state.ResumeTiming();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["cycles_per_instruction"] = (double) cycles / state.iterations();
+
+    delete start;
+    delete bus;
+}
+
+// Prologues are made of 2-byte instructions only
+BENCHMARK_CAPTURE(run_block, load_immediate, {}, {0xA9, 0x42}, {2});            // LDA #$42
+BENCHMARK_CAPTURE(run_block, alu_immediate, {}, {0x69, 0x01}, {2});             // ADC #$01
+BENCHMARK_CAPTURE(run_block, load_zero_page, {}, {0xA5, 0x10}, {3});            // LDA $10
+BENCHMARK_CAPTURE(run_block, load_absolute_x, {}, {0xBD, 0x00, 0x03}, {4});     // LDA $0300,X
+BENCHMARK_CAPTURE(run_block, store_absolute, {}, {0x8D, 0x00, 0x03}, {4});      // STA $0300
+BENCHMARK_CAPTURE(run_block, read_modify_write, {}, {0xE6, 0x10}, {5});         // INC $10
+BENCHMARK_CAPTURE(run_block, shift_accumulator, {}, {0x0A}, {2});               // ASL A
+BENCHMARK_CAPTURE(run_block, implied, {}, {0xCA}, {2});                         // DEX
+BENCHMARK_CAPTURE(run_block, stack, {}, {0x48, 0x68}, {3, 4});                  // PHA, PLA
+// The CPU doesn't count the extra cycle of a taken branch yet, update this when it does
+BENCHMARK_CAPTURE(run_block, branch_taken, {0xA9, 0x00}, {0xF0, 0x00}, {2});    // LDA #0, then BEQ to the next instruction
+// No branch_not_taken: the CPU doesn't skip the operand of a branch that isn't taken, so any workload
+// for it would half measure whatever the operand decodes to
+
+// BENCHMARK_MAIN, except that a broken workload makes the run fail
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return workload_failed ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+// Nanoseconds per frame of background rendering, on synthetic screens and optionally on real ROMs.
+// Run with --benchmark_format=json (or --benchmark_out=file.json) for machine-readable results;
+// real_time is the time per frame. Set NES_BENCH_ROMS to a colon-separated list of ROM paths
+// to also time whole frames of those games.
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <random>
+
+#include "../src/bus.h"
+#include "../src/nes.h"
+
+enum ScreenUpdate {
+    Static,       // Nothing changes, every frame comes from the background cache
+    ScrollOnly,   // Fine scroll changes every frame
+    DirtyTiles,   // A row of name table entries is rewritten every frame
+    FullRedraw    // The whole background is drawn again every frame
+};
+
+static void fill_screen(Bus* bus) {
+    std::mt19937 random(1234);
+    uint8_t data[0x1000];
+
+    // Random patterns for the background pattern table and random tiles on the first name table
+    for (int i = 0; i < 0x1000; i++) {
+        data[i] = random();
+    }
+    bus->write_array_to_ppu(data, 0x0000, 0x1000);
+    bus->write_array_to_ppu(data, 0x2000, 0x0400);
+
+    for (uint8_t i = 0; i < 0x20; i++) {
+        bus->write_to_ppu(0x3F00 + i, (i * 7) & 0x3F);
+    }
+}
+
+static void run_frame(PPU* ppu) {
+    while (!ppu->is_frame_complete()) {
+        ppu->step(DOTS_PER_SCANLINE);
+    }
+    ppu->clear_frame_complete();
+}
+
+static void render_background(benchmark::State& state, ScreenUpdate update) {
+    Bus* bus = new Bus();
+    PPU* ppu = bus->get_ppu();
+
+    fill_screen(bus);
+    bus->write_to_memory(0x2001, 0x0A); // Show the background, including the leftmost column
+    run_frame(ppu);
+
+    uint8_t frame = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        switch (update) {
+            case ScrollOnly: {
+                bus->write_to_memory(0x2005, frame);
+                bus->write_to_memory(0x2005, 0);
+                break;
+            }
+            case DirtyTiles: {
+                for (uint16_t i = 0; i < 32; i++) {
+                    bus->write_to_ppu(0x2000 + (frame % 30) * 32 + i, frame + i);
+                }
+                break;
+            }
+            case FullRedraw: {
+                ppu->invalidate_background();
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+        frame++;
+        state.ResumeTiming();
+
+        run_frame(ppu);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete bus;
+}
+
+BENCHMARK_CAPTURE(render_background, static, Static);
+BENCHMARK_CAPTURE(render_background, scroll_only, ScrollOnly);
+BENCHMARK_CAPTURE(render_background, dirty_tiles, DirtyTiles);
+BENCHMARK_CAPTURE(render_background, full_redraw, FullRedraw);
+
+// Whole frames of a real game: CPU, PPU and APU together
+static void run_rom(benchmark::State& state, std::string rom_path) {
+    NES* nes = new NES();
+
+    if (!nes->load_rom(rom_path.c_str())) {
+        state.SkipWithError("Could not load the ROM");
+        delete nes;
+        return;
+    }
+
+    nes->set_audio_enabled(false);
+
+    for (auto _ : state) {
+        nes->run_frame();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    delete nes;
+}
+
+int main(int argc, char** argv) {
+    const char* rom_paths = getenv("NES_BENCH_ROMS");
+
+    if (rom_paths) {
+        std::stringstream paths(rom_paths);
+        std::string path;
+
+        while (std::getline(paths, path, ':')) {
+            if (!path.empty()) {
+                benchmark::RegisterBenchmark(("run_rom/" + path).c_str(), run_rom, path);
+            }
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
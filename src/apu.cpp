@@ -0,0 +1,633 @@
+#include "apu.h"
+
+#include <algorithm>
+
+APU::APU() {
+    memset(pulse, 0, sizeof(pulse));
+    memset(&triangle, 0, sizeof(triangle));
+    memset(&noise, 0, sizeof(noise));
+    memset(&dmc, 0, sizeof(dmc));
+
+    noise.shift_register = 1;
+    noise.timer_period = noise_table[0];
+    dmc.timer_period = dmc_table[0];
+    dmc.sample_buffer_empty = true;
+    dmc.bits_remaining = 8;
+    dmc.silence = true;
+
+    five_step = false;
+    irq_inhibit = false;
+    frame_irq = false;
+    frame_cycle = 0;
+    odd_cycle = false;
+
+    // Approximations of the non-linear mixer from the NESdev wiki
+    pulse_mix[0] = 0;
+    for (int i = 1; i < 31; i++) {
+        pulse_mix[i] = (int32_t) (AUDIO_AMPLITUDE * 95.52 / (8128.0 / i + 100.0));
+    }
+
+    tnd_mix[0] = 0;
+    for (int i = 1; i < 203; i++) {
+        tnd_mix[i] = (int32_t) (AUDIO_AMPLITUDE * 163.67 / (24329.0 / i + 100.0));
+    }
+
+    output = nullptr;
+    output_enabled = true;
+    blip = new BlipBuffer(CPU_CLOCK_RATE, AUDIO_SAMPLE_RATE);
+    frame_time = 0;
+    amplitude = 0;
+    output_changed = true; // The first cycle mixes the power-on level
+    idle_cycles = 0;
+    cycles_to_event = 0;
+}
+
+APU::~APU() {
+    delete blip;
+}
+
+void APU::save_state(APUState& state) {
+    catch_up();
+
+    memcpy(state.pulse, pulse, sizeof(pulse));
+    state.triangle = triangle;
+    state.noise = noise;
+    state.dmc = dmc;
+
+    state.five_step = five_step;
+    state.irq_inhibit = irq_inhibit;
+    state.frame_irq = frame_irq;
+    state.frame_cycle = frame_cycle;
+    state.odd_cycle = odd_cycle;
+}
+
+void APU::load_state(const APUState& state) {
+    memcpy(pulse, state.pulse, sizeof(pulse));
+    triangle = state.triangle;
+    noise = state.noise;
+    dmc = state.dmc;
+
+    five_step = state.five_step;
+    irq_inhibit = state.irq_inhibit;
+    frame_irq = state.frame_irq;
+    frame_cycle = state.frame_cycle;
+    odd_cycle = state.odd_cycle;
+
+    // The restored channels may sound different, without this a silent one wouldn't be mixed until the next event
+    output_changed = true;
+    idle_cycles = 0;
+}
+
+void APU::write_register(uint16_t address, uint8_t value) {
+    // The timers have to be where they would be when the write changes what they do
+    catch_up();
+    output_changed = true;
+
+    switch (address) {
+        case 0x4000:
+        case 0x4004: {
+            PulseChannel& channel = pulse[(address - 0x4000) >> 2];
+            channel.duty = value >> 6;
+            channel.envelope.loop = value & 0x20;
+            channel.envelope.constant_volume = value & 0x10;
+            channel.envelope.volume = value & 0x0F;
+            break;
+        }
+        case 0x4001:
+        case 0x4005: {
+            PulseChannel& channel = pulse[(address - 0x4000) >> 2];
+            channel.sweep_enabled = value & 0x80;
+            channel.sweep_period = (value >> 4) & 0x07;
+            channel.sweep_negate = value & 0x08;
+            channel.sweep_shift = value & 0x07;
+            channel.sweep_reload = true;
+            break;
+        }
+        case 0x4002:
+        case 0x4006: {
+            PulseChannel& channel = pulse[(address - 0x4000) >> 2];
+            channel.timer_period = (channel.timer_period & 0x700) | value;
+            break;
+        }
+        case 0x4003:
+        case 0x4007: {
+            PulseChannel& channel = pulse[(address - 0x4000) >> 2];
+            channel.timer_period = (channel.timer_period & 0xFF) | ((value & 0x07) << 8);
+            if (channel.enabled) {
+                channel.length = length_table[value >> 3];
+            }
+            channel.sequence_step = 0;
+            channel.envelope.start = true;
+            break;
+        }
+        case 0x4008: {
+            triangle.control = value & 0x80;
+            triangle.linear_reload_value = value & 0x7F;
+            break;
+        }
+        case 0x400A: {
+            triangle.timer_period = (triangle.timer_period & 0x700) | value;
+            break;
+        }
+        case 0x400B: {
+            triangle.timer_period = (triangle.timer_period & 0xFF) | ((value & 0x07) << 8);
+            if (triangle.enabled) {
+                triangle.length = length_table[value >> 3];
+            }
+            triangle.linear_reload = true;
+            break;
+        }
+        case 0x400C: {
+            noise.envelope.loop = value & 0x20;
+            noise.envelope.constant_volume = value & 0x10;
+            noise.envelope.volume = value & 0x0F;
+            break;
+        }
+        case 0x400E: {
+            noise.mode = value & 0x80;
+            noise.timer_period = noise_table[value & 0x0F];
+            break;
+        }
+        case 0x400F: {
+            if (noise.enabled) {
+                noise.length = length_table[value >> 3];
+            }
+            noise.envelope.start = true;
+            break;
+        }
+        case 0x4010: {
+            dmc.irq_enabled = value & 0x80;
+            if (!dmc.irq_enabled) {
+                dmc.irq_flag = false;
+            }
+            dmc.loop = value & 0x40;
+            dmc.timer_period = dmc_table[value & 0x0F];
+            break;
+        }
+        case 0x4011: {
+            dmc.output_level = value & 0x7F;
+            break;
+        }
+        case 0x4012: {
+            dmc.sample_address = 0xC000 + value * 64;
+            break;
+        }
+        case 0x4013: {
+            dmc.sample_length = value * 16 + 1;
+            break;
+        }
+        case APU_STATUS_REGISTER: {
+            // Disabling a channel silences it right away by clearing its length counter
+            pulse[0].enabled = value & 0x01;
+            pulse[1].enabled = value & 0x02;
+            triangle.enabled = value & 0x04;
+            noise.enabled = value & 0x08;
+
+            if (!pulse[0].enabled) pulse[0].length = 0;
+            if (!pulse[1].enabled) pulse[1].length = 0;
+            if (!triangle.enabled) triangle.length = 0;
+            if (!noise.enabled) noise.length = 0;
+
+            if (!(value & 0x10)) {
+                dmc.bytes_remaining = 0;
+            } else if (dmc.bytes_remaining == 0) {
+                restart_dmc();
+            }
+            dmc.irq_flag = false;
+            break;
+        }
+        case APU_FRAME_COUNTER_REGISTER: {
+            five_step = value & 0x80;
+            irq_inhibit = value & 0x40;
+            if (irq_inhibit) {
+                frame_irq = false;
+            }
+
+            frame_cycle = 0;
+            if (five_step) {
+                // The 5-step sequence clocks everything immediately
+                clock_quarter_frame();
+                clock_half_frame();
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+uint8_t APU::read_status() {
+    uint8_t status = (pulse[0].length > 0)
+                   | (pulse[1].length > 0) << 1
+                   | (triangle.length > 0) << 2
+                   | (noise.length > 0) << 3
+                   | (dmc.bytes_remaining > 0) << 4
+                   | frame_irq << 6
+                   | dmc.irq_flag << 7;
+
+    // Reading acknowledges the frame interrupt
+    frame_irq = false;
+
+    return status;
+}
+
+void APU::clock_envelope(Envelope& envelope) {
+    if (envelope.start) {
+        envelope.start = false;
+        envelope.decay = 15;
+        envelope.divider = envelope.volume;
+    } else if (envelope.divider == 0) {
+        envelope.divider = envelope.volume;
+
+        if (envelope.decay > 0) {
+            envelope.decay--;
+        } else if (envelope.loop) {
+            envelope.decay = 15;
+        }
+    } else {
+        envelope.divider--;
+    }
+}
+
+uint16_t APU::sweep_target(uint8_t channel) {
+    PulseChannel& p = pulse[channel];
+    uint16_t change = p.timer_period >> p.sweep_shift;
+
+    if (p.sweep_negate) {
+        // Pulse 1 negates with one's complement, pulse 2 with two's complement
+        return p.timer_period - change - (channel == 0 ? 1 : 0);
+    }
+
+    return p.timer_period + change;
+}
+
+bool APU::is_pulse_muted(uint8_t channel) {
+    return pulse[channel].timer_period < 8 || sweep_target(channel) > 0x7FF;
+}
+
+void APU::clock_quarter_frame() {
+    clock_envelope(pulse[0].envelope);
+    clock_envelope(pulse[1].envelope);
+    clock_envelope(noise.envelope);
+
+    if (triangle.linear_reload) {
+        triangle.linear_counter = triangle.linear_reload_value;
+    } else if (triangle.linear_counter > 0) {
+        triangle.linear_counter--;
+    }
+
+    if (!triangle.control) {
+        triangle.linear_reload = false;
+    }
+}
+
+void APU::clock_half_frame() {
+    for (uint8_t i = 0; i < 2; i++) {
+        PulseChannel& p = pulse[i];
+
+        if (!p.envelope.loop && p.length > 0) {
+            p.length--;
+        }
+
+        if (p.sweep_divider == 0 && p.sweep_enabled && p.sweep_shift > 0 && !is_pulse_muted(i)) {
+            p.timer_period = sweep_target(i);
+        }
+
+        if (p.sweep_divider == 0 || p.sweep_reload) {
+            p.sweep_divider = p.sweep_period;
+            p.sweep_reload = false;
+        } else {
+            p.sweep_divider--;
+        }
+    }
+
+    if (!triangle.control && triangle.length > 0) {
+        triangle.length--;
+    }
+
+    if (!noise.envelope.loop && noise.length > 0) {
+        noise.length--;
+    }
+}
+
+void APU::restart_dmc() {
+    dmc.current_address = dmc.sample_address;
+    dmc.bytes_remaining = dmc.sample_length;
+}
+
+void APU::fetch_dmc_sample() {
+    // The real DMC stalls the CPU for a few cycles here, that isn't emulated
+    dmc.sample_buffer = bus->read_from_cpu(dmc.current_address);
+    dmc.sample_buffer_empty = false;
+    dmc.current_address = dmc.current_address == 0xFFFF ? 0x8000 : dmc.current_address + 1;
+    dmc.bytes_remaining--;
+
+    if (dmc.bytes_remaining == 0) {
+        if (dmc.loop) {
+            restart_dmc();
+        } else if (dmc.irq_enabled) {
+            dmc.irq_flag = true;
+        }
+    }
+}
+
+void APU::clock_dmc() {
+    if (!dmc.silence) {
+        if (dmc.shift_register & 1) {
+            if (dmc.output_level <= 125) {
+                dmc.output_level += 2;
+            }
+        } else if (dmc.output_level >= 2) {
+            dmc.output_level -= 2;
+        }
+        dmc.shift_register >>= 1;
+    }
+
+    if (--dmc.bits_remaining == 0) {
+        dmc.bits_remaining = 8;
+
+        if (dmc.sample_buffer_empty) {
+            dmc.silence = true;
+        } else {
+            dmc.silence = false;
+            dmc.shift_register = dmc.sample_buffer;
+            dmc.sample_buffer_empty = true;
+        }
+    }
+
+    if (dmc.sample_buffer_empty && dmc.bytes_remaining > 0) {
+        fetch_dmc_sample();
+    }
+}
+
+uint8_t APU::envelope_output(const Envelope& envelope) {
+    return envelope.constant_volume ? envelope.volume : envelope.decay;
+}
+
+uint8_t APU::pulse_output(uint8_t channel) {
+    PulseChannel& p = pulse[channel];
+    bool audible = p.length > 0 && duty_table[p.duty][p.sequence_step] && !is_pulse_muted(channel);
+    return audible ? envelope_output(p.envelope) : 0;
+}
+
+uint8_t APU::noise_output() {
+    return noise.length > 0 && !(noise.shift_register & 1) ? envelope_output(noise.envelope) : 0;
+}
+
+int32_t APU::mix() {
+    return pulse_mix[pulse_output(0) + pulse_output(1)] + tnd_mix[3 * triangle_table[triangle.sequence_step] + 2 * noise_output() + dmc.output_level];
+}
+
+// Whether a channel's timer running out can change its output. Only the frame counter and register writes can
+// change that, so it holds until the next event.
+bool APU::is_pulse_active(uint8_t channel) {
+    PulseChannel& p = pulse[channel];
+    return p.length > 0 && envelope_output(p.envelope) > 0 && !is_pulse_muted(channel);
+}
+
+bool APU::is_triangle_active() {
+    return triangle.length > 0 && triangle.linear_counter > 0;
+}
+
+bool APU::is_noise_active() {
+    return noise.length > 0 && envelope_output(noise.envelope) > 0;
+}
+
+bool APU::is_dmc_active() {
+    // An idle DMC only counts down its bits, nothing it outputs or flags changes
+    return !dmc.silence || !dmc.sample_buffer_empty || dmc.bytes_remaining > 0;
+}
+
+// Timers count down once per clock and are reloaded on the clock after reaching 0, which clocks their unit
+static uint16_t count_down(uint16_t timer, uint16_t reload, uint32_t ticks, uint32_t& clocks) {
+    if (ticks <= timer) {
+        clocks = 0;
+        return timer - ticks;
+    }
+
+    ticks -= timer + 1;
+    clocks = 1 + ticks / (reload + 1);
+
+    return reload - ticks % (reload + 1);
+}
+
+uint32_t APU::cycles_until_event() {
+    // The cycle frame_cycle is incremented to the next step on
+    uint32_t next_step;
+    if (frame_cycle < FRAME_COUNTER_STEP_1) {
+        next_step = FRAME_COUNTER_STEP_1;
+    } else if (frame_cycle < FRAME_COUNTER_STEP_2) {
+        next_step = FRAME_COUNTER_STEP_2;
+    } else if (frame_cycle < FRAME_COUNTER_STEP_3) {
+        next_step = FRAME_COUNTER_STEP_3;
+    } else if (frame_cycle < FRAME_COUNTER_STEP_4 && !five_step) {
+        next_step = FRAME_COUNTER_STEP_4;
+    } else if (frame_cycle < FRAME_COUNTER_STEP_5 && five_step) {
+        next_step = FRAME_COUNTER_STEP_5;
+    } else {
+        // Only reachable by restoring an odd state, the counter wraps around
+        next_step = 0x10000;
+    }
+
+    uint32_t until = next_step - frame_cycle - 1;
+
+    // Pulse timers only count on odd cycles
+    uint32_t first_pulse_cycle = odd_cycle ? 0 : 1;
+    for (uint8_t i = 0; i < 2; i++) {
+        if (is_pulse_active(i)) {
+            until = std::min<uint32_t>(until, first_pulse_cycle + 2 * pulse[i].timer);
+        }
+    }
+
+    if (is_triangle_active()) {
+        until = std::min<uint32_t>(until, triangle.timer);
+    }
+
+    if (is_noise_active()) {
+        until = std::min<uint32_t>(until, noise.timer);
+    }
+
+    if (is_dmc_active()) {
+        until = std::min<uint32_t>(until, dmc.timer);
+    }
+
+    return until;
+}
+
+void APU::skip_cycles(uint32_t cycles) {
+    // No active channel's timer runs out in here, the others may and are caught up without touching the output
+    uint32_t clocks;
+
+    triangle.timer = count_down(triangle.timer, triangle.timer_period, cycles, clocks);
+
+    noise.timer = count_down(noise.timer, noise.timer_period - 1, cycles, clocks);
+    for (uint32_t i = 0; i < clocks; i++) {
+        clock_noise();
+    }
+
+    dmc.timer = count_down(dmc.timer, dmc.timer_period - 1, cycles, clocks);
+    dmc.bits_remaining = (dmc.bits_remaining + 7 - clocks % 8) % 8 + 1;
+
+    uint32_t pulse_ticks = odd_cycle ? (cycles + 1) / 2 : cycles / 2;
+    for (uint8_t i = 0; i < 2; i++) {
+        pulse[i].timer = count_down(pulse[i].timer, pulse[i].timer_period, pulse_ticks, clocks);
+        pulse[i].sequence_step = (pulse[i].sequence_step + clocks) & 0x07;
+    }
+
+    odd_cycle ^= cycles & 1;
+    frame_cycle += cycles;
+}
+
+void APU::clock_noise() {
+    uint16_t feedback = (noise.shift_register ^ (noise.shift_register >> (noise.mode ? 6 : 1))) & 1;
+    noise.shift_register = (noise.shift_register >> 1) | (feedback << 14);
+}
+
+void APU::run_cycle() {
+    // Triangle, noise and DMC timers count CPU cycles, the pulse timers every other one
+    if (triangle.timer == 0) {
+        triangle.timer = triangle.timer_period;
+        if (is_triangle_active()) {
+            uint8_t level = triangle_table[triangle.sequence_step];
+            triangle.sequence_step = (triangle.sequence_step + 1) & 0x1F;
+            output_changed |= triangle_table[triangle.sequence_step] != level;
+        }
+    } else {
+        triangle.timer--;
+    }
+
+    if (noise.timer == 0) {
+        noise.timer = noise.timer_period - 1;
+        uint8_t level = noise_output();
+        clock_noise();
+        output_changed |= noise_output() != level;
+    } else {
+        noise.timer--;
+    }
+
+    if (dmc.timer == 0) {
+        dmc.timer = dmc.timer_period - 1;
+        uint8_t level = dmc.output_level;
+        clock_dmc();
+        output_changed |= dmc.output_level != level;
+    } else {
+        dmc.timer--;
+    }
+
+    if (odd_cycle) {
+        for (uint8_t i = 0; i < 2; i++) {
+            if (pulse[i].timer == 0) {
+                pulse[i].timer = pulse[i].timer_period;
+                uint8_t level = pulse_output(i);
+                pulse[i].sequence_step = (pulse[i].sequence_step + 1) & 0x07;
+                output_changed |= pulse_output(i) != level;
+            } else {
+                pulse[i].timer--;
+            }
+        }
+    }
+    odd_cycle = !odd_cycle;
+
+    // Envelopes, sweeps and length counters can change any channel's output
+    frame_cycle++;
+    switch (frame_cycle) {
+        case FRAME_COUNTER_STEP_1:
+        case FRAME_COUNTER_STEP_3: {
+            clock_quarter_frame();
+            output_changed = true;
+            break;
+        }
+        case FRAME_COUNTER_STEP_2: {
+            clock_quarter_frame();
+            clock_half_frame();
+            output_changed = true;
+            break;
+        }
+        case FRAME_COUNTER_STEP_4: {
+            if (!five_step) {
+                clock_quarter_frame();
+                clock_half_frame();
+                output_changed = true;
+                if (!irq_inhibit) {
+                    frame_irq = true;
+                }
+                frame_cycle = 0;
+            }
+            break;
+        }
+        case FRAME_COUNTER_STEP_5: {
+            clock_quarter_frame();
+            clock_half_frame();
+            output_changed = true;
+            frame_cycle = 0;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+void APU::catch_up() {
+    skip_cycles(idle_cycles);
+    idle_cycles = 0;
+}
+
+void APU::step(uint16_t cycles) {
+    // Most calls end before the next event, all they do is count
+    if (!output_changed && idle_cycles + cycles <= cycles_to_event) {
+        idle_cycles += cycles;
+        frame_time += cycles;
+        return;
+    }
+
+    catch_up();
+
+    bool sampling = output && output_enabled;
+    uint32_t cycle = 0;
+
+    // Only cycles on which a timer of an audible channel runs out or the frame counter steps are run one by one,
+    // everything in between is skipped in one go. A register write is picked up on the first cycle.
+    while (true) {
+        uint32_t until = output_changed ? 0 : cycles_until_event();
+
+        if (cycle + until >= cycles) {
+            skip_cycles(cycles - cycle);
+            cycles_to_event = until - (cycles - cycle);
+            break;
+        }
+
+        skip_cycles(until);
+        cycle += until;
+
+        run_cycle();
+
+        if (sampling && output_changed) {
+            int32_t new_amplitude = mix();
+            if (new_amplitude != amplitude) {
+                blip->add_delta(frame_time + cycle, new_amplitude - amplitude);
+                amplitude = new_amplitude;
+            }
+        }
+        output_changed = false;
+
+        cycle++;
+    }
+
+    frame_time += cycles;
+}
+
+void APU::end_frame() {
+    if (output && output_enabled) {
+        blip->end_frame(frame_time);
+
+        uint32_t count;
+        while ((count = blip->read_samples(batch, AUDIO_BATCH_SIZE)) > 0) {
+            // When the output is full the rest is dropped, the consumer is falling behind anyway
+            output->write(batch, count);
+        }
+    }
+
+    frame_time = 0;
+}
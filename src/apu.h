@@ -0,0 +1,211 @@
+#ifndef APU_H
+#define APU_H
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#define CPU_CLOCK_RATE 1789773 // NTSC
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_BATCH_SIZE 256 // Samples are handed to the output in batches of this size
+#define AUDIO_AMPLITUDE 32767 // Output amplitude of the mixer at full scale
+
+#define APU_REGISTERS_START 0x4000
+#define APU_REGISTERS_END 0x4013
+#define APU_STATUS_REGISTER 0x4015
+#define APU_FRAME_COUNTER_REGISTER 0x4017
+
+// Frame counter steps, in CPU cycles
+#define FRAME_COUNTER_STEP_1 7457
+#define FRAME_COUNTER_STEP_2 14913
+#define FRAME_COUNTER_STEP_3 22371
+#define FRAME_COUNTER_STEP_4 29829
+#define FRAME_COUNTER_STEP_5 37281
+
+struct Envelope {
+    bool start;
+    bool loop; // Also halts the length counter
+    bool constant_volume;
+    uint8_t volume; // Constant volume, or the divider period
+    uint8_t divider;
+    uint8_t decay;
+};
+
+struct PulseChannel {
+    bool enabled;
+    uint8_t duty;
+    uint8_t sequence_step;
+    uint16_t timer_period;
+    uint16_t timer;
+    uint8_t length;
+    Envelope envelope;
+
+    bool sweep_enabled;
+    bool sweep_negate;
+    bool sweep_reload;
+    uint8_t sweep_period;
+    uint8_t sweep_shift;
+    uint8_t sweep_divider;
+};
+
+struct TriangleChannel {
+    bool enabled;
+    bool control; // Also halts the length counter
+    uint8_t linear_reload_value;
+    uint8_t linear_counter;
+    bool linear_reload;
+    uint16_t timer_period;
+    uint16_t timer;
+    uint8_t sequence_step;
+    uint8_t length;
+};
+
+struct NoiseChannel {
+    bool enabled;
+    bool mode;
+    uint16_t timer_period;
+    uint16_t timer;
+    uint16_t shift_register;
+    uint8_t length;
+    Envelope envelope;
+};
+
+struct DMCChannel {
+    bool irq_enabled;
+    bool irq_flag;
+    bool loop;
+    uint16_t timer_period;
+    uint16_t timer;
+    uint8_t output_level;
+
+    uint16_t sample_address;
+    uint16_t sample_length;
+    uint16_t current_address;
+    uint16_t bytes_remaining;
+    uint8_t sample_buffer;
+    bool sample_buffer_empty;
+
+    uint8_t shift_register;
+    uint8_t bits_remaining;
+    bool silence;
+};
+
+// Everything needed to restore the APU to an earlier point
+struct APUState {
+    PulseChannel pulse[2];
+    TriangleChannel triangle;
+    NoiseChannel noise;
+    DMCChannel dmc;
+
+    bool five_step;
+    bool irq_inhibit;
+    bool frame_irq;
+    uint16_t frame_cycle;
+    bool odd_cycle;
+};
+
+#include "bus.h"
+#include "audio_buffer.h"
+#include "blip_buffer.h"
+
+class Bus;
+class APU {
+private:
+    Bus* bus; // The DMC fetches its samples from CPU memory
+
+    PulseChannel pulse[2];
+    TriangleChannel triangle;
+    NoiseChannel noise;
+    DMCChannel dmc;
+
+    // Frame counter, clocks the envelopes, sweeps and length counters
+    bool five_step;
+    bool irq_inhibit;
+    bool frame_irq;
+    uint16_t frame_cycle;
+    bool odd_cycle; // Pulse timers run at half the CPU clock
+
+    constexpr static uint8_t length_table[32] = {
+        10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+        12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+    };
+    constexpr static uint8_t duty_table[4][8] = {
+        {0, 1, 0, 0, 0, 0, 0, 0},
+        {0, 1, 1, 0, 0, 0, 0, 0},
+        {0, 1, 1, 1, 1, 0, 0, 0},
+        {1, 0, 0, 1, 1, 1, 1, 1}
+    };
+    constexpr static uint8_t triangle_table[32] = {
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+    constexpr static uint16_t noise_table[16] = {
+        4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
+    };
+    constexpr static uint16_t dmc_table[16] = {
+        428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54
+    };
+
+    // Non-linear DAC, indexed by the summed channel outputs, scaled to AUDIO_AMPLITUDE
+    int32_t pulse_mix[31];
+    int32_t tnd_mix[203];
+
+    // The mixer output only changes now and then, only those changes go into the band-limited synthesis
+    AudioBuffer* output;
+    bool output_enabled;
+    BlipBuffer* blip;
+    uint32_t frame_time; // CPU cycles since the last end_frame
+    int32_t amplitude; // Last amplitude handed to blip
+    bool output_changed; // A channel's output level changed this cycle, or something that may change it happened
+    uint32_t cycles_to_event; // Counted from the last cycle that was run
+    uint32_t idle_cycles; // Cycles stepped since then, not yet counted off the timers
+    int16_t batch[AUDIO_BATCH_SIZE];
+
+    void clock_envelope(Envelope& envelope);
+    uint16_t sweep_target(uint8_t channel);
+    bool is_pulse_muted(uint8_t channel);
+    void clock_quarter_frame();
+    void clock_half_frame();
+    void clock_dmc();
+    void fetch_dmc_sample();
+    void restart_dmc();
+    void clock_noise();
+
+    uint8_t envelope_output(const Envelope& envelope);
+    uint8_t pulse_output(uint8_t channel);
+    uint8_t noise_output();
+    int32_t mix();
+
+    // The APU runs from event to event, channels that can't be heard don't have any
+    bool is_pulse_active(uint8_t channel);
+    bool is_triangle_active();
+    bool is_noise_active();
+    bool is_dmc_active();
+    uint32_t cycles_until_event();
+    void skip_cycles(uint32_t cycles); // Up to, not including, the next event
+    void run_cycle();
+    void catch_up(); // Bring the timers up to date with the stepped cycles
+public:
+    APU();
+    ~APU();
+
+    void set_bus(Bus* bus_ptr) { bus = bus_ptr; }
+
+    void save_state(APUState& state);
+    void load_state(const APUState& state);
+
+    void write_register(uint16_t address, uint8_t value);
+    uint8_t read_status(); // $4015
+
+    void step(uint16_t cycles); // Run for a number of CPU cycles
+    void end_frame(); // Render the samples of the frame so far and hand them to the output
+    bool is_irq_pending() { return frame_irq || dmc.irq_flag; }
+
+    // Samples go to output while enabled, and nowhere when there's no output or it's disabled
+    void set_output(AudioBuffer* output_ptr) { output = output_ptr; }
+    void set_output_enabled(bool enabled) { output_enabled = enabled; }
+    void set_sample_rate(double rate) { blip->set_rates(CPU_CLOCK_RATE, rate); } // Nudged by rate control
+    bool is_output_enabled() { return output_enabled; }
+};
+
+#endif
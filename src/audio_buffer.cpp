@@ -0,0 +1,58 @@
+#include "audio_buffer.h"
+
+AudioBuffer::AudioBuffer(uint32_t min_capacity) {
+    capacity = 1;
+    while (capacity < min_capacity) {
+        capacity <<= 1;
+    }
+
+    mask = capacity - 1;
+    samples = new int16_t[capacity];
+    memset(samples, 0, capacity * sizeof(int16_t));
+
+    head.store(0);
+    tail.store(0);
+    underruns.store(0);
+    overflowed_samples.store(0);
+}
+
+AudioBuffer::~AudioBuffer() {
+    delete[] samples;
+}
+
+uint32_t AudioBuffer::write(const int16_t* data, uint32_t count) {
+    uint32_t write_index = head.load(std::memory_order_relaxed);
+    uint32_t free = capacity - (write_index - tail.load(std::memory_order_acquire));
+
+    if (count > free) {
+        overflowed_samples.fetch_add(count - free, std::memory_order_relaxed);
+        count = free;
+    }
+
+    // At most two copies, the second one for the part that wraps around
+    uint32_t start = write_index & mask;
+    uint32_t first = count < capacity - start ? count : capacity - start;
+    memcpy(samples + start, data, first * sizeof(int16_t));
+    memcpy(samples, data + first, (count - first) * sizeof(int16_t));
+
+    head.store(write_index + count, std::memory_order_release);
+    return count;
+}
+
+uint32_t AudioBuffer::read(int16_t* data, uint32_t count) {
+    uint32_t read_index = tail.load(std::memory_order_relaxed);
+    uint32_t available = head.load(std::memory_order_acquire) - read_index;
+
+    if (count > available) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+        count = available;
+    }
+
+    uint32_t start = read_index & mask;
+    uint32_t first = count < capacity - start ? count : capacity - start;
+    memcpy(data, samples + start, first * sizeof(int16_t));
+    memcpy(data + first, samples, (count - first) * sizeof(int16_t));
+
+    tail.store(read_index + count, std::memory_order_release);
+    return count;
+}
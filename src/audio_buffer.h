@@ -0,0 +1,39 @@
+#ifndef AUDIO_BUFFER_H
+#define AUDIO_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Single-producer/single-consumer ring of samples between the emulator and the audio callback.
+// Neither side ever locks or allocates, so the audio thread can't be held up by emulation.
+class AudioBuffer {
+private:
+    int16_t* samples;
+    uint32_t capacity; // Power of two, so indices can wrap with a mask
+    uint32_t mask;
+
+    // Free running counters, only the producer writes head and only the consumer writes tail
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+
+    // Reads that came up short and samples that didn't fit, for monitoring
+    std::atomic<uint32_t> underruns;
+    std::atomic<uint32_t> overflowed_samples;
+public:
+    AudioBuffer(uint32_t min_capacity);
+    ~AudioBuffer();
+
+    // Producer side, returns the number of samples that fit
+    uint32_t write(const int16_t* data, uint32_t count);
+
+    // Consumer side, returns the number of samples that were available
+    uint32_t read(int16_t* data, uint32_t count);
+
+    uint32_t get_fill() { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    uint32_t get_capacity() { return capacity; }
+    uint32_t get_underruns() { return underruns.load(std::memory_order_relaxed); }
+    uint32_t get_overflowed_samples() { return overflowed_samples.load(std::memory_order_relaxed); }
+};
+
+#endif
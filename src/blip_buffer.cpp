@@ -0,0 +1,93 @@
+#include "blip_buffer.h"
+
+BlipBuffer::BlipBuffer(double clock_rate, double sample_rate) {
+    // Windowed sinc impulses with the cutoff a little below Nyquist, one for every phase
+    const double cutoff = 0.9;
+
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        double taps[BLIP_KERNEL_WIDTH];
+        double sum = 0;
+
+        for (int i = 0; i < BLIP_KERNEL_WIDTH; i++) {
+            double t = i - (BLIP_KERNEL_WIDTH / 2 - 1) - (double) phase / BLIP_PHASES;
+            double sinc = t == 0 ? 1 : sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+            double window = 0.42 + 0.5 * cos(2 * M_PI * t / BLIP_KERNEL_WIDTH) + 0.08 * cos(4 * M_PI * t / BLIP_KERNEL_WIDTH);
+
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // Every kernel has to add up to exactly one unit, or steps would leave a DC error behind
+        int32_t total = 0;
+        for (int i = 0; i < BLIP_KERNEL_WIDTH; i++) {
+            kernels[phase][i] = (int16_t) lround(taps[i] / sum * (1 << BLIP_KERNEL_BITS));
+            total += kernels[phase][i];
+        }
+        kernels[phase][BLIP_KERNEL_WIDTH / 2 - 1] += (1 << BLIP_KERNEL_BITS) - total;
+    }
+
+    set_rates(clock_rate, sample_rate);
+    clear();
+}
+
+BlipBuffer::~BlipBuffer() {}
+
+void BlipBuffer::set_rates(double clock_rate, double sample_rate) {
+    factor = (uint64_t) (sample_rate / clock_rate * ((uint64_t) 1 << BLIP_TIME_BITS));
+}
+
+void BlipBuffer::clear() {
+    memset(buffer, 0, sizeof(buffer));
+    offset = 0;
+    integrator = 0;
+}
+
+void BlipBuffer::add_delta(uint32_t time, int32_t delta) {
+    uint64_t position = offset + time * factor;
+    uint32_t index = (uint32_t) (position >> BLIP_TIME_BITS);
+
+    if (index >= BLIP_BUFFER_SIZE) {
+        // Nobody is reading, there's no room left for this frame
+        return;
+    }
+
+    const int16_t* kernel = kernels[(position >> (BLIP_TIME_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+    int32_t* destination = buffer + index;
+
+    for (int i = 0; i < BLIP_KERNEL_WIDTH; i++) {
+        destination[i] += kernel[i] * delta;
+    }
+}
+
+void BlipBuffer::end_frame(uint32_t duration) {
+    offset += duration * factor;
+
+    if ((offset >> BLIP_TIME_BITS) > BLIP_BUFFER_SIZE) {
+        offset = (uint64_t) BLIP_BUFFER_SIZE << BLIP_TIME_BITS;
+    }
+}
+
+uint32_t BlipBuffer::read_samples(int16_t* output, uint32_t count) {
+    uint32_t available = get_samples_available();
+    if (count > available) {
+        count = available;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        // The buffer holds differences, the running sum is the signal
+        integrator += buffer[i];
+        int32_t sample = integrator >> BLIP_KERNEL_BITS;
+        output[i] = sample > 32767 ? 32767 : (sample < -32768 ? -32768 : (int16_t) sample);
+
+        integrator -= sample << (BLIP_KERNEL_BITS - BLIP_BASS_SHIFT);
+    }
+
+    // Keep what's left, including the tails of the kernels that reach past the end of the frame
+    uint32_t remaining = available - count + BLIP_KERNEL_WIDTH;
+    memmove(buffer, buffer + count, remaining * sizeof(int32_t));
+    memset(buffer + remaining, 0, count * sizeof(int32_t));
+
+    offset -= (uint64_t) count << BLIP_TIME_BITS;
+
+    return count;
+}
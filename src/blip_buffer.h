@@ -0,0 +1,43 @@
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#define BLIP_BUFFER_SIZE 4096 // Output samples, a frame needs about 800
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS) // Sub-sample positions a step can start at
+#define BLIP_KERNEL_WIDTH 16 // Output samples touched by each step
+#define BLIP_KERNEL_BITS 14 // Fixed point precision of the kernels
+#define BLIP_TIME_BITS 32 // Fractional bits of positions in the output
+#define BLIP_BASS_SHIFT 7 // DC blocking high-pass, about 60 Hz at 48 kHz
+
+// Band-limited step synthesis. Instead of generating a sample for every clock and filtering,
+// changes in amplitude are added as deltas at the clock they happen on and spread over a few
+// output samples with a precomputed band-limited impulse. Integrating the result when it is
+// read gives alias-free steps directly at the output rate.
+class BlipBuffer {
+private:
+    int32_t buffer[BLIP_BUFFER_SIZE + BLIP_KERNEL_WIDTH];
+    int16_t kernels[BLIP_PHASES][BLIP_KERNEL_WIDTH];
+
+    uint64_t factor; // Output samples per clock, fixed point
+    uint64_t offset; // Position of the start of the current frame in the output, fixed point
+    int32_t integrator;
+public:
+    BlipBuffer(double clock_rate, double sample_rate);
+    ~BlipBuffer();
+
+    void set_rates(double clock_rate, double sample_rate);
+    void clear();
+
+    // time is in clocks since the start of the current frame
+    void add_delta(uint32_t time, int32_t delta);
+    void end_frame(uint32_t duration);
+
+    uint32_t get_samples_available() { return (uint32_t) (offset >> BLIP_TIME_BITS); }
+    uint32_t read_samples(int16_t* output, uint32_t count);
+};
+
+#endif
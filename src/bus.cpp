@@ -1,4 +1,5 @@
 #include "bus.h"
+#include "instrumentation.h"
 
 Bus::Bus() {
     reset();
@@ -7,6 +8,7 @@ Bus::Bus() {
 Bus::~Bus() {
     delete cpu;
     delete ppu;
+    delete apu;
 }
 
 void Bus::reset() {
@@ -16,12 +18,56 @@ void Bus::reset() {
     ppu = new PPU();
     ppu->set_bus(this);
 
+    apu = new APU();
+    apu->set_bus(this);
+
     memset(cpu_memory, 0, CPU_MEMORY_SIZE);
     memset(ppu_memory, 0, PPU_MEMORY_SIZE * 4);
     memset(spr_ram, 0, SPR_RAM_SIZE);
+    dma_cycles = 0;
 
     controllers[0] = nullptr;
     controllers[1] = nullptr;
+
+    cartridge = nullptr;
+    cdl = nullptr;
+
+    reset_stats();
+    detailed_timing = false;
+}
+
+void Bus::save_state(MachineState& state) {
+    memcpy(state.cpu_memory, cpu_memory, CPU_MEMORY_SIZE);
+    memcpy(state.ppu_memory, ppu_memory, PPU_MEMORY_SIZE * 4);
+    memcpy(state.spr_ram, spr_ram, SPR_RAM_SIZE);
+    state.dma_cycles = dma_cycles;
+
+    cpu->save_state(state.cpu);
+    ppu->save_state(state.ppu);
+    apu->save_state(state.apu);
+
+    for (int i = 0; i < 2; i++) {
+        if (controllers[i]) {
+            controllers[i]->save_state(state.controllers[i]);
+        }
+    }
+}
+
+void Bus::load_state(const MachineState& state) {
+    memcpy(cpu_memory, state.cpu_memory, CPU_MEMORY_SIZE);
+    memcpy(ppu_memory, state.ppu_memory, PPU_MEMORY_SIZE * 4);
+    memcpy(spr_ram, state.spr_ram, SPR_RAM_SIZE);
+    dma_cycles = state.dma_cycles;
+
+    cpu->load_state(state.cpu);
+    ppu->load_state(state.ppu);
+    apu->load_state(state.apu);
+
+    for (int i = 0; i < 2; i++) {
+        if (controllers[i]) {
+            controllers[i]->load_state(state.controllers[i]);
+        }
+    }
 }
 
 void Bus::attach_cartridge(Cartridge* cartridge_ptr) {
@@ -29,13 +75,42 @@ void Bus::attach_cartridge(Cartridge* cartridge_ptr) {
 }
 
 uint8_t Bus::read_from_cpu(uint16_t address) {
+    if (cdl) {
+        cdl->log(address, CDL_DATA);
+    }
+
+    return read_cpu_memory(address);
+}
+
+uint8_t Bus::fetch_from_cpu(uint16_t address, uint8_t usage) {
+    if (cdl) {
+        cdl->log(address, usage);
+    }
+
+    return read_cpu_memory(address);
+}
+
+uint8_t Bus::read_cpu_memory(uint16_t address) {
+    if (address >= IO_REGISTERS_START && address < 0x4000) {
+        // The 8 PPU registers are mirrored up to $3FFF
+        ZONE("ppu register read");
+        return ppu->read_register(IO_REGISTERS_START + (address & 0x7));
+    }
+
     switch (address) {
+        case APU_STATUS_REGISTER: {
+            ZONE("apu status read");
+            return apu->read_status();
+        }
+
         case 0x4016: {
-            return controllers[0]->read();
+            ZONE("controller read");
+            return controllers[0] ? controllers[0]->read() : 0;
         }
 
         case 0x4017: {
-            return controllers[1]->read();
+            ZONE("controller read");
+            return controllers[1] ? controllers[1]->read() : 0;
         }
 
         default: {
@@ -45,43 +120,144 @@ uint8_t Bus::read_from_cpu(uint16_t address) {
 }
 
 void Bus::write_to_memory(uint16_t address, uint8_t value) {
-    cpu_memory[address] = value;
+    if (address >= IO_REGISTERS_START && address < 0x4000) {
+        ZONE("ppu register write");
+        ppu->write_register(IO_REGISTERS_START + (address & 0x7), value);
+        return;
+    }
+
+    if (address >= APU_REGISTERS_START && address <= APU_REGISTERS_END) {
+        ZONE("apu register write");
+        apu->write_register(address, value);
+        return;
+    }
+
+    switch (address) {
+        case SPR_RAM_DMA: {
+            // Copy a page of CPU memory into SPR-RAM, starting at the current SPR-RAM address
+            ZONE("oam dma");
+            uint16_t page = value << 8;
+            for (int i = 0; i < SPR_RAM_SIZE; i++) {
+                ppu->write_register(SPR_RAM_IO_REGISTER, read_from_cpu(page + i));
+            }
+
+            dma_cycles += SPR_RAM_DMA_CYCLES;
+
+            break;
+        }
+
+        case 0x4016: {
+            // The strobe goes to both controllers
+            ZONE("controller write");
+            for (int i = 0; i < 2; i++) {
+                if (controllers[i]) {
+                    controllers[i]->write(value);
+                }
+            }
+
+            break;
+        }
+
+        case APU_STATUS_REGISTER:
+        case APU_FRAME_COUNTER_REGISTER: {
+            // $4017 is the second controller when read, but the APU frame counter when written
+            ZONE("apu register write");
+            apu->write_register(address, value);
+            break;
+        }
+
+        default: {
+            cpu_memory[address] = value;
+        }
+    }
 }
 
-void Bus::write_array_to_memory(uint8_t* data, uint16_t start, uint16_t size) {
+void Bus::write_array_to_memory(const uint8_t* data, uint16_t start, uint16_t size) {
     cpu->write_data_to_memory(data, start, size);
 }
 
-void Bus::execute_next_instruction() {
-    cpu->execute_next_instruction();
+uint16_t Bus::execute_next_instruction() {
+    // The IRQ line is level triggered, it stays asserted until the APU is acknowledged
+    cpu->set_irq_line(apu->is_irq_pending());
+
+    uint16_t cycles;
+    {
+        ScopedTimer timer(detailed_timing ? &stats.cpu_ticks : nullptr);
+        ZONE("cpu instruction");
+        cycles = cpu->execute_next_instruction();
+    }
+
+    // The CPU is halted while a DMA transfer runs, but the PPU keeps going
+    cycles += dma_cycles;
+    dma_cycles = 0;
+    cpu->profile_cycles(cycles);
+
+    // The PPU runs 3 dots for every CPU cycle
+    stats.instructions++;
+    stats.cpu_cycles += cycles;
+
+    ppu->step(cycles * 3);
+
+    ScopedTimer timer(detailed_timing ? &stats.apu_ticks : nullptr);
+    apu->step(cycles);
+
+    return cycles;
 }
 
-uint8_t Bus::read_from_ppu(uint16_t address) {
-    if (address < 0x3000  && address >= 0x2000) {
+void Bus::request_nmi() {
+    cpu->request_nmi();
+}
+
+uint16_t Bus::mirror_ppu_address(uint16_t address) {
+    address &= 0x3FFF;
+
+    if (address >= 0x3000 && address < IMAGE_PALETTE_BOTTOM) {
+        // $3000-$3EFF mirrors the name tables
+        address -= 0x1000;
+    }
+
+    if (address >= IMAGE_PALETTE_BOTTOM) {
+        // The palette is mirrored every 32 bytes, and the first entry of each sprite palette is the matching image palette entry
+        address = IMAGE_PALETTE_BOTTOM + (address & 0x1F);
+
+        if ((address & 0x13) == 0x10) {
+            address &= ~0x10;
+        }
+    }
+
+    if (address < 0x3000  && address >= 0x2000 && cartridge) {
         if (cartridge->get_mirror_type()) {
             // Vertical mirroring
-            address &= 0x7FF;
+            address &= 0x27FF;
         } else {
             // Horizontal mirroring
-            address &= 0xBFF;
+            address &= 0x2BFF;
         }
     }
-    
-    return ppu_memory[address];
+
+    return address;
+}
+
+uint8_t Bus::read_from_ppu(uint16_t address) {
+    return ppu_memory[mirror_ppu_address(address)];
 }
 
 void Bus::write_to_ppu(uint16_t address, uint8_t value) {
-    if (address < 0x3000  && address >= 0x2000) {
-        if (cartridge->get_mirror_type()) {
-            // Vertical mirroring
-            address &= 0x7FF;
-        } else {
-            // Horizontal mirroring
-            address &= 0xBFF;
-        }
+    address = mirror_ppu_address(address);
+
+    // Rewriting the same value is common and doesn't change anything on screen
+    if (ppu_memory[address] == value) {
+        return;
     }
 
     ppu_memory[address] = value;
+    ppu->mark_dirty(address);
+}
+
+void Bus::write_array_to_ppu(const uint8_t* data, uint16_t start, uint16_t size) {
+    for (int i = 0; i < size; i++) {
+        write_to_ppu(start + i, data[i]);
+    }
 }
 
 void Bus::attach_controller(Controller* controller) {
@@ -2,45 +2,96 @@
 #define BUS_H
 
 #define CPU_MEMORY_SIZE 0x10000 // 64 KiB
+#define CPU_RAM_SIZE 0x0800 // 2 KiB of internal RAM at $0000, mirrored up to $1FFF
 #define PPU_MEMORY_SIZE 0x4000 // 16 KiB
 #define SPR_RAM_SIZE 0x100 // 256 bytes
 #define CPU_STACK_BOTTOM 0x0100
 #define CPU_STACK_SIZE 0xFF
+#define SPR_RAM_DMA 0x4014
+#define SPR_RAM_DMA_CYCLES 513
 
 #include <cstring>
 
+#include "stats.h"
+#include "code_data_logger.h"
 #include "controller.h"
 #include "cpu.h"
 #include "cartridge.h"
 #include "ppu.h"
+#include "apu.h"
+
+// Snapshot of the entire machine, restoring it is a handful of memcpys
+struct MachineState {
+    uint8_t cpu_memory[CPU_MEMORY_SIZE];
+    uint8_t ppu_memory[PPU_MEMORY_SIZE * 4];
+    uint8_t spr_ram[SPR_RAM_SIZE];
+    uint16_t dma_cycles;
+
+    CPUState cpu;
+    PPUState ppu;
+    APUState apu;
+    ControllerState controllers[2];
+};
 
 class CPU;
 class PPU;
+class APU;
 class Bus {
 private:
     uint8_t cpu_memory[CPU_MEMORY_SIZE];
     uint8_t ppu_memory[PPU_MEMORY_SIZE * 4];
     uint8_t spr_ram[SPR_RAM_SIZE];
 
+    // CPU cycles still to be stalled by a SPR-RAM DMA transfer
+    uint16_t dma_cycles;
+
     Controller* controllers[2];
     Cartridge* cartridge;
     CPU* cpu;
     PPU* ppu;
+    APU* apu;
+
+    FrameStats stats;
+    bool detailed_timing; // Time every instruction, for the HUD
+
+    CodeDataLogger* cdl; // Only set while logging
+
+    uint8_t read_cpu_memory(uint16_t address); // Reads without logging the access
 public:
     Bus();
     ~Bus();
 
     void reset();
 
+    CPU* get_cpu() { return cpu; }
+    const uint8_t* get_cpu_ram() { return cpu_memory; } // CPU_RAM_SIZE bytes
+    PPU* get_ppu() { return ppu; }
+    APU* get_apu() { return apu; }
+
+    FrameStats& get_stats() { return stats; }
+    void reset_stats() { memset(&stats, 0, sizeof(stats)); }
+    void set_detailed_timing(bool enabled) { detailed_timing = enabled; }
+
+    void save_state(MachineState& state);
+    void load_state(const MachineState& state);
+
     void attach_cartridge(Cartridge* cartridge_ptr);
+    void attach_code_data_logger(CodeDataLogger* logger) { cdl = logger; }
 
-    uint8_t read_from_cpu(uint16_t address);
+    uint8_t read_from_cpu(uint16_t address); // Data reads
+    uint8_t fetch_from_cpu(uint16_t address, uint8_t usage); // Instruction fetches, usage is CDL_OPCODE or CDL_OPERAND
     void write_to_memory(uint16_t address, uint8_t value);
-    void write_array_to_memory(uint8_t* data, uint16_t start, uint16_t size);
-    void execute_next_instruction();
+    void write_array_to_memory(const uint8_t* data, uint16_t start, uint16_t size);
+    uint16_t execute_next_instruction(); // Returns the number of CPU cycles taken, including DMA stalls
+    void request_nmi();
 
+    uint16_t mirror_ppu_address(uint16_t address); // Resolve name table mirroring
     uint8_t read_from_ppu(uint16_t address);
     void write_to_ppu(uint16_t address, uint8_t value);
+    void write_array_to_ppu(const uint8_t* data, uint16_t start, uint16_t size);
+
+    uint8_t read_from_spr_ram(uint8_t address) { return spr_ram[address]; }
+    void write_to_spr_ram(uint8_t address, uint8_t value) { spr_ram[address] = value; }
     
     //void initialize_controllers(int amount);
     void attach_controller(Controller* controller);
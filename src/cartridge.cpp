@@ -1,30 +1,55 @@
 #include "cartridge.h"
 
+#include <algorithm>
+
 Cartridge::Cartridge(std::ifstream& input) {
-    if (!input) {
-        std::cout << "Failed to open ROM" << std::endl;
-        exit(1);
-    }
+    // Read the 16-byte header into the buffer, a file that failed to open reads nothing
+    unsigned char header[INES_HEADER_SIZE];
+    input.read((char*) header, INES_HEADER_SIZE);
+
+    parse_header(header, input.gcount());
+}
+
+Cartridge::Cartridge(const uint8_t* data, size_t size) {
+    parse_header(data, size);
+}
 
-    // Read the 16-byte header into the buffer
-    unsigned char header[16];
-    
-    input.read((char*) header, 16);
+Cartridge::~Cartridge() {}
+
+void Cartridge::reject(const char* reason) {
+    valid_header = false;
+    error = reason;
+    std::cout << reason << std::endl;
+}
 
-    /*
-    for (int i = 0; i < 16; i++) {
-        std::cout << (int) header[i] << std::endl;
+void Cartridge::parse_header(const uint8_t* header, size_t size) {
+    valid_header = false;
+    nes2 = false;
+    nr_prg_rom_banks = 0;
+    nr_chr_rom_banks = 0;
+    nr_ram_banks = 0;
+    prg_ram_size = 0;
+    prg_nvram_size = 0;
+    chr_ram_size = 0;
+    mirror_type = false;
+    battery_backed_ram = false;
+    trainer = false;
+    four_screen_mirroring = false;
+    mapper_number = 0;
+    submapper = 0;
+
+    if (size < INES_HEADER_SIZE) {
+        reject("Invalid file header: file too short");
+        return;
     }
-    */
 
     // Check if first 4 bytes are correct
     if (strncmp((char*) header, "NES", 3) != 0 || header[3] != 0x1A) {
-        std::cout << "Invalid file header" << std::endl;
-        exit(1);
+        reject("Invalid file header");
+        return;
     }
 
     nr_prg_rom_banks = (uint8_t) header[4];
-    //std::cout << ((uint8_t) header[4] == 1) << " PRG BANKS" << std::endl;
     nr_chr_rom_banks = (uint8_t) header[5];
 
     uint8_t control_byte_1 = header[6];
@@ -34,17 +59,33 @@ Cartridge::Cartridge(std::ifstream& input) {
 
     battery_backed_ram = (control_byte_1 & 0x02) >> 1;
 
-    trainer = (control_byte_1 & 0x40) >> 2;
+    trainer = (control_byte_1 & 0x04) >> 2;
 
     four_screen_mirroring = (control_byte_1 & 0x08) >> 3;
 
-    if (control_byte_2 & 0x0F != 0) {
-        std::cout << "Invalid file header: Invalid control byte 2" << std::endl;
-        exit(1);
+    // Compose the mapper number from the upper 4 bits of each control byte
+    mapper_number = (control_byte_2 & 0xF0) | ((control_byte_1 & 0xF0) >> 4);
+
+    // NES 2.0 marks itself with bits 2 and 3 of control byte 2
+    if ((control_byte_2 & 0x0C) == 0x08) {
+        nes2 = true;
+
+        if (!parse_nes2_header(header)) {
+            return;
+        }
+
+        valid_header = true;
+        print();
+        return;
     }
 
-    // Compose the mapper number from the lowest 4 bits of each control byte
-    mapper_number = (control_byte_2 & 0xF0) | ((control_byte_1 & 0xF0) >> 4);
+    // Old tools left their name in bytes 7 to 15 ("DiskDude!"), so the upper half of the mapper number in byte 7
+    // can't be trusted when its format bits say 01 or any of bytes 12 to 15, which iNES 1.0 leaves 0, isn't 0.
+    // Bytes 9 to 11 aren't checked, some dumps use 9 and 10 for TV system and PRG-RAM flags.
+    if ((control_byte_2 & 0x0C) == 0x04 || header[12] != 0 || header[13] != 0 || header[14] != 0 || header[15] != 0) {
+        std::cout << "Byte 7 has the format bits 01 or bytes 12 to 15 of the header are not zero, ignoring the upper half of the mapper number" << std::endl;
+        mapper_number &= 0x0F;
+    }
 
     // If the header says 0, it means 1
     if (header[8] == 0) {
@@ -53,28 +94,101 @@ Cartridge::Cartridge(std::ifstream& input) {
         nr_ram_banks = header[8];
     }
 
-    // Bytes 9 to 15 should be 0
-    for (int i = 9; i < 16; i++) {
-        if (header[i] != 0) {
-            std::cout << "Invalid file header: bytes 9 to 15 not zero" << std::endl;
-            exit(1);
-        }
+    if (battery_backed_ram) {
+        prg_nvram_size = nr_ram_banks * 0x2000;
+    } else {
+        prg_ram_size = nr_ram_banks * 0x2000;
     }
 
+    // Without CHR-ROM the pattern tables are 8 KB of RAM
+    chr_ram_size = nr_chr_rom_banks == 0 ? CHR_ROM_BANK_SIZE : 0;
+
     valid_header = true;
     print();
 }
 
-Cartridge::~Cartridge() {}
+// Sizes are in units of banks with the upper 4 bits in byte 9, or in exponent-multiplier notation when those are all set
+static bool parse_nes2_rom_size(uint8_t lsb, uint8_t msb, uint32_t bank_size, uint16_t& nr_of_banks) {
+    if (msb != 0x0F) {
+        nr_of_banks = (msb << 8) | lsb;
+        return true;
+    }
+
+    uint8_t exponent = lsb >> 2;
+    if (exponent > 30) {
+        return false;
+    }
+
+    // Only whole banks can be mapped
+    uint64_t size = (1ULL << exponent) * ((lsb & 0x03) * 2 + 1);
+    if (size % bank_size != 0 || size / bank_size > 0xFFFF) {
+        return false;
+    }
+
+    nr_of_banks = size / bank_size;
+    return true;
+}
+
+static uint32_t nes2_ram_size(uint8_t shift) {
+    return shift == 0 ? 0 : 64u << shift;
+}
+
+bool Cartridge::parse_nes2_header(const uint8_t* header) {
+    mapper_number |= (header[8] & 0x0F) << 8;
+    submapper = header[8] >> 4;
+
+    if (!parse_nes2_rom_size(header[4], header[9] & 0x0F, PRG_ROM_BANK_SIZE, nr_prg_rom_banks)) {
+        reject("Invalid file header: PRG-ROM size isn't a whole number of banks");
+        return false;
+    }
+
+    if (!parse_nes2_rom_size(header[5], header[9] >> 4, CHR_ROM_BANK_SIZE, nr_chr_rom_banks)) {
+        reject("Invalid file header: CHR-ROM size isn't a whole number of banks");
+        return false;
+    }
+
+    // RAM sizes are 64 << n bytes, 0 meaning none; battery backed CHR-RAM is rare enough to count as plain CHR-RAM
+    prg_ram_size = nes2_ram_size(header[10] & 0x0F);
+    prg_nvram_size = nes2_ram_size(header[10] >> 4);
+    chr_ram_size = nes2_ram_size(header[11] & 0x0F) + nes2_ram_size(header[11] >> 4);
+
+    nr_ram_banks = std::max<uint32_t>(1, (prg_ram_size + prg_nvram_size + 0x1FFF) / 0x2000);
+    return true;
+}
+
+void Cartridge::apply_database_entry(const RomDatabaseEntry& entry) {
+    mapper_number = entry.mapper_number;
+    submapper = entry.submapper;
+    mirror_type = entry.mirroring == VerticalMirroring;
+    four_screen_mirroring = entry.mirroring == FourScreenMirroring;
+    battery_backed_ram = entry.battery_backed_ram;
+    prg_ram_size = entry.prg_ram_size;
+    prg_nvram_size = entry.prg_nvram_size;
+    chr_ram_size = entry.chr_ram_size;
+    nr_ram_banks = std::max<uint32_t>(1, (prg_ram_size + prg_nvram_size + 0x1FFF) / 0x2000);
+}
+
+size_t Cartridge::get_rom_size() {
+    return INES_HEADER_SIZE + (trainer ? TRAINER_SIZE : 0) + (size_t) nr_prg_rom_banks * PRG_ROM_BANK_SIZE + (size_t) nr_chr_rom_banks * CHR_ROM_BANK_SIZE;
+}
+
+uint16_t Cartridge::get_prg_bank(uint8_t window) {
+    if (window == 0 || nr_prg_rom_banks <= 1) {
+        return 0;
+    }
+
+    // UNROM keeps the last bank fixed at $C000, otherwise the second bank sits there
+    return mapper_number == 2 ? nr_prg_rom_banks - 1 : 1;
+}
 
 void Cartridge::print() {
     std::cout << "--- ROM INFO ---" << std::endl;
-    std::cout << "Header valid: " << valid_header << std::endl;
+    std::cout << "Header valid: " << valid_header << (nes2 ? " (NES 2.0)" : "") << std::endl;
     std::cout << "PRG ROM banks: " << (int) nr_prg_rom_banks << std::endl;
     std::cout << "CHR ROM banks: " << (int) nr_chr_rom_banks << std::endl;
-    std::cout << "RAM banks: " << (int) nr_ram_banks << std::endl;
+    std::cout << "RAM banks: " << (int) nr_ram_banks << " (PRG-RAM " << prg_ram_size << ", battery backed " << prg_nvram_size << ", CHR-RAM " << chr_ram_size << " bytes)" << std::endl;
     std::cout << "Mirror type: " << mirror_type << std::endl;
     std::cout << "Battery backed RAM: " << battery_backed_ram << std::endl;
     std::cout << "Four screen mirroring: " << four_screen_mirroring << std::endl;
-    std::cout << "Mapper number: " << (int) mapper_number << std::endl;
+    std::cout << "Mapper number: " << (int) mapper_number << (nes2 ? ", submapper " + std::to_string(submapper) : "") << std::endl;
 }
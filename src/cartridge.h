@@ -8,19 +8,34 @@
 #include <iostream>
 #include <vector>
 
+#include "rom_database.h"
+
+#define INES_HEADER_SIZE 16
+#define TRAINER_SIZE 512
+#define PRG_ROM_BANK_SIZE 0x4000 // 16 KB
+#define CHR_ROM_BANK_SIZE 0x2000 // 8 KB
+
 class Cartridge {
     private:
         // Indicates a valid iNES-header
         bool valid_header;
 
+        // Indicates an NES 2.0 header, which also gives the submapper and exact RAM sizes
+        bool nes2;
+
         // The number of 16 KB PRG-ROM banks, where program code is stored
-        uint8_t nr_prg_rom_banks;
+        uint16_t nr_prg_rom_banks;
 
         // The number of 8 KB CHR-ROM banks, where graphics information is stored
-        uint8_t nr_chr_rom_banks;
+        uint16_t nr_chr_rom_banks;
 
-        // The number of 8 KB RAM banks
-        uint8_t nr_ram_banks;
+        // The number of 8 KB RAM banks, NES 2.0 PRG-RAM and PRG-NVRAM of 2 MB each make 512
+        uint16_t nr_ram_banks;
+
+        // RAM sizes in bytes; NES 2.0 gives them, for iNES 1.0 they follow from the RAM banks and the CHR-ROM banks
+        uint32_t prg_ram_size;
+        uint32_t prg_nvram_size;
+        uint32_t chr_ram_size;
 
         // False: horizontal mirroring; True: vertical mirroring
         bool mirror_type;
@@ -34,24 +49,51 @@ class Cartridge {
         // Indicates that four-screen mirroring should be used
         bool four_screen_mirroring;
 
-        // Compose the mapper number from the lowest 4 bits of each control byte
-        uint8_t mapper_number;
+        // Composed from the upper 4 bits of each control byte, NES 2.0 adds 4 more bits
+        uint16_t mapper_number;
+
+        // Variant of the mapper, NES 2.0 only
+        uint8_t submapper;
+
+        // Why the header was rejected, empty for a valid header
+        std::string error;
+
+        void parse_header(const uint8_t* header, size_t size);
+        bool parse_nes2_header(const uint8_t* header);
+        void reject(const char* reason);
 
     public:
+        // Both only parse the header; bad input leaves is_valid_header() false instead of exiting
         Cartridge(std::ifstream& input);
+        Cartridge(const uint8_t* data, size_t size);
         ~Cartridge();
         
         void print();
 
         bool is_valid_header() { return valid_header; }
-        uint8_t get_nr_prg_rom_banks() { return nr_prg_rom_banks; }
-        uint8_t get_nr_chr_rom_banks() { return nr_chr_rom_banks; }
-        uint8_t get_nr_ram_banks() { return nr_ram_banks; }
+        bool is_nes2() { return nes2; }
+        uint16_t get_nr_prg_rom_banks() { return nr_prg_rom_banks; }
+        uint16_t get_nr_chr_rom_banks() { return nr_chr_rom_banks; }
+        uint16_t get_nr_ram_banks() { return nr_ram_banks; }
         bool get_mirror_type() { return mirror_type; }
         bool has_battery_backed_ram() { return battery_backed_ram; }
         bool has_trainer() { return trainer; }
         bool has_four_screen_mirroring() { return four_screen_mirroring; }
-        uint8_t get_mapper_number() { return mapper_number; }
+        uint16_t get_mapper_number() { return mapper_number; }
+        uint8_t get_submapper() { return submapper; }
+        uint32_t get_prg_ram_size() { return prg_ram_size; }
+        uint32_t get_prg_nvram_size() { return prg_nvram_size; }
+        uint32_t get_chr_ram_size() { return chr_ram_size; }
+        const std::string& get_error() { return error; }
+
+        // Size of the header, trainer and ROM banks together, a file must be at least this big
+        size_t get_rom_size();
+
+        // PRG-ROM bank mapped at $8000 (window 0) or $C000 (window 1) after power-on
+        uint16_t get_prg_bank(uint8_t window);
+
+        // Replace what the header says with what a database knows about the ROM
+        void apply_database_entry(const RomDatabaseEntry& entry);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "code_data_logger.h"
+
+CodeDataLogger::CodeDataLogger(uint32_t prg_rom_size) {
+    size = prg_rom_size;
+    flags = new uint8_t[size];
+    memset(flags, 0, size);
+
+    window_offsets[0] = 0;
+    window_offsets[1] = 0;
+}
+
+CodeDataLogger::~CodeDataLogger() {
+    delete[] flags;
+}
+
+uint32_t CodeDataLogger::count(uint8_t usage) {
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < size; i++) {
+        total += (flags[i] & usage) != 0;
+    }
+
+    return total;
+}
+
+bool CodeDataLogger::save(const char* path) {
+    std::ofstream output(path, std::ios::binary);
+    output.write((const char*) flags, size);
+
+    if (!output) {
+        std::cout << "Failed to write the CDL file " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool CodeDataLogger::load(const char* path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        std::cout << "Failed to open the CDL file " << path << std::endl;
+        return false;
+    }
+
+    uint8_t* loaded = new uint8_t[size];
+    input.read((char*) loaded, size);
+
+    // A log of another ROM would only be misleading
+    if ((uint32_t) input.gcount() != size || input.peek() != EOF) {
+        std::cout << "The CDL file " << path << " doesn't match the size of the PRG-ROM" << std::endl;
+        delete[] loaded;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < size; i++) {
+        flags[i] |= loaded[i];
+    }
+
+    delete[] loaded;
+    return true;
+}
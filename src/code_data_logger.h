@@ -0,0 +1,47 @@
+#ifndef CODE_DATA_LOGGER_H
+#define CODE_DATA_LOGGER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+
+// Flags kept for every byte of PRG-ROM
+#define CDL_OPCODE 0x01  // Fetched as the first byte of an instruction
+#define CDL_DATA 0x02    // Read by an instruction
+#define CDL_OPERAND 0x04 // Fetched as an operand of an instruction
+
+#define CDL_WINDOW_SIZE 0x4000 // PRG-ROM is mapped in two 16 KB windows, at $8000 and $C000
+
+// Code/Data Logger: remembers how every PRG-ROM byte has been used, one flag byte per ROM byte.
+// The file is just those flag bytes, loading one merges it so sessions add up.
+class CodeDataLogger {
+private:
+    uint8_t* flags;
+    uint32_t size;
+
+    // ROM offset of the bank visible in each window
+    uint32_t window_offsets[2];
+public:
+    CodeDataLogger(uint32_t prg_rom_size);
+    ~CodeDataLogger();
+
+    void map_window(uint8_t window, uint16_t bank) { window_offsets[window] = bank * CDL_WINDOW_SIZE; }
+
+    // Called on every CPU read, so kept to a compare and an OR
+    void log(uint16_t address, uint8_t usage) {
+        if (address >= 0x8000) {
+            flags[window_offsets[(address >> 14) & 1] + (address & (CDL_WINDOW_SIZE - 1))] |= usage;
+        }
+    }
+
+    const uint8_t* get_flags() { return flags; }
+    uint32_t get_size() { return size; }
+    uint32_t count(uint8_t usage); // Bytes that have any of the usage flags
+
+    void clear() { memset(flags, 0, size); }
+    bool save(const char* path);
+    bool load(const char* path);
+};
+
+#endif
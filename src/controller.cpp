@@ -27,8 +27,37 @@ void Controller::set_button(uint8_t button_index, bool pressed) {
     }
 }
 
+uint8_t Controller::get_state() {
+    uint8_t state = 0;
+
+    for (int i = 0; i < NR_OF_BUTTONS; i++) {
+        state |= buttons[i] << i;
+    }
+
+    return state;
+}
+
+void Controller::set_state(uint8_t state) {
+    for (int i = 0; i < NR_OF_BUTTONS; i++) {
+        buttons[i] = (state >> i) & 0b1;
+    }
+}
+
+void Controller::save_state(ControllerState& state) {
+    state.buttons = get_state();
+    state.strobe = strobe;
+    state.index = index;
+}
+
+void Controller::load_state(const ControllerState& state) {
+    set_state(state.buttons);
+    strobe = state.strobe;
+    index = state.index;
+}
+
 uint8_t Controller::read() {
-    uint8_t result;
+    // After all 8 buttons have been read, an official controller keeps returning 1
+    uint8_t result = 1;
 
     if (index < 8) {
         result = buttons[index];
@@ -7,6 +7,12 @@
 #include <cstring>
 #include <iostream>
 
+struct ControllerState {
+    uint8_t buttons;
+    uint8_t strobe;
+    uint8_t index;
+};
+
 class Controller {
 private:
     bool buttons[8];
@@ -20,6 +26,13 @@ public:
     void write(uint8_t value);
     void set_button(uint8_t button_index, bool pressed);
 
+    // All 8 buttons packed into a byte, button 0 in bit 0
+    uint8_t get_state();
+    void set_state(uint8_t state);
+
+    void save_state(ControllerState& state);
+    void load_state(const ControllerState& state);
+
     uint8_t read();
 };
 
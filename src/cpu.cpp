@@ -13,9 +13,53 @@ void CPU::initialize() {
     X = 0;
     Y = 0;
     P = 0;
+
+    // Interrupts start out disabled, as on a real reset; the APU frame counter would fire right away otherwise
+    set_status_bit(InterruptDisable, true);
+
+    cycles = 0;
+    nmi_pending = false;
+    irq_line = false;
+    profiler = nullptr;
+}
+
+void CPU::reset() {
+    // The reset sequence goes through the motions of pushing PC and P, but nothing gets written
+    SP -= 3;
+    set_status_bit(InterruptDisable, true);
+    PC = merge_uint8_t(bus->read_from_cpu(0xFFFD), bus->read_from_cpu(0xFFFC));
+
+    nmi_pending = false;
+    cycles += 7;
+
+    if (profiler) {
+        profiler->reset_call_stack();
+    }
+}
+
+void CPU::save_state(CPUState& state) {
+    state.PC = PC;
+    state.SP = SP;
+    state.A = A;
+    state.X = X;
+    state.Y = Y;
+    state.P = P;
+    state.cycles = cycles;
+    state.nmi_pending = nmi_pending;
 }
 
-void CPU::write_data_to_memory(uint8_t* data, uint16_t start, uint16_t size) {
+void CPU::load_state(const CPUState& state) {
+    PC = state.PC;
+    SP = state.SP;
+    A = state.A;
+    X = state.X;
+    Y = state.Y;
+    P = state.P;
+    cycles = state.cycles;
+    nmi_pending = state.nmi_pending;
+}
+
+void CPU::write_data_to_memory(const uint8_t* data, uint16_t start, uint16_t size) {
     assert(MEMORY_SIZE - size >= start);
 
     for (int i = 0; i < size; i++) {
@@ -40,7 +84,7 @@ uint16_t CPU::merge_uint8_t(uint8_t upper, uint8_t lower) {
 }
 
 uint8_t CPU::next_prg_byte() {
-    return bus->read_from_cpu(PC++);
+    return bus->fetch_from_cpu(PC++, CDL_OPERAND);
 }
 
 void CPU::push(uint8_t byte) {
@@ -97,10 +141,30 @@ void CPU::interrupt(InterruptType type) {
             break;
         }
     }
+
+    if (profiler) {
+        profiler->enter(PC, type == NMI ? CallNMI : CallIRQ, SP);
+    }
 }
 
-void CPU::execute_next_instruction() {
-    uint8_t opcode = next_prg_byte();
+uint8_t CPU::execute_next_instruction() {
+    if (nmi_pending) {
+        nmi_pending = false;
+        interrupt(NMI);
+
+        // Servicing an interrupt takes 7 cycles
+        cycles += 7;
+        return 7;
+    }
+
+    if (irq_line && !get_status_bit(InterruptDisable)) {
+        interrupt(IRQ);
+
+        cycles += 7;
+        return 7;
+    }
+
+    uint8_t opcode = bus->fetch_from_cpu(PC++, CDL_OPCODE);
 
     if (group_1A.count(static_cast<Instruction>(opcode & 0xE3)) == 1) {
         // Instruction is of type 1A
@@ -130,6 +194,9 @@ void CPU::execute_next_instruction() {
         // Instruction is of type 4
         execute_4(opcode);
     }
+
+    cycles += instruction_cycles[opcode];
+    return instruction_cycles[opcode];
 }
 
 void CPU::execute_1A(uint8_t opcode) {
@@ -629,6 +696,10 @@ void CPU::execute_4(uint8_t opcode) {
             P = pop();
             PC = merge_uint8_t(pop(), pop());
 
+            if (profiler) {
+                profiler->leave(SP);
+            }
+
             break;
         }
 
@@ -638,6 +709,10 @@ void CPU::execute_4(uint8_t opcode) {
             PC = merge_uint8_t(pop(), pop());
             PC += 1;
 
+            if (profiler) {
+                profiler->leave(SP);
+            }
+
             break;
         }
 
@@ -728,6 +803,10 @@ void CPU::execute_4(uint8_t opcode) {
 
             PC = merge_uint8_t(upper_arg, lower_arg);
 
+            if (profiler) {
+                profiler->enter(PC, CallSubroutine, SP);
+            }
+
             break;
         }
 
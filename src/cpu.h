@@ -14,7 +14,20 @@
 #include <set>
 #include <iostream>
 
+// Everything needed to restore the CPU to an earlier point
+struct CPUState {
+    uint16_t PC;
+    uint8_t SP;
+    uint8_t A;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t P;
+    uint64_t cycles;
+    bool nmi_pending;
+};
+
 #include "bus.h"
+#include "profiler.h"
 
 enum StatusBit { Negative = 0, Overflow, NotUsed, Break, DecimalMode, InterruptDisable, Zero, Carry };
 enum InterruptType { NMI, IRQ, RES };
@@ -56,6 +69,32 @@ private:
         Bit 7: Negative */
     uint8_t P;
 
+    uint64_t cycles; // Total number of cycles executed
+    bool nmi_pending; // Set by the PPU when vblank starts
+    bool irq_line; // Level of the IRQ line, driven by the APU before every instruction
+
+    Profiler* profiler; // Only set while profiling
+
+    // Base number of cycles per opcode; page crossings and taken branches are not counted
+    constexpr static uint8_t instruction_cycles[256] = {
+        7, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 4, 4, 6, 6,
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+        6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 4, 4, 6, 6,
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+        6, 6, 2, 8, 3, 3, 5, 5, 3, 2, 2, 2, 3, 4, 6, 6,
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+        6, 6, 2, 8, 3, 3, 5, 5, 4, 2, 2, 2, 5, 4, 6, 6,
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+        2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
+        2, 6, 2, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,
+        2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,
+        2, 5, 2, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,
+        2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7,
+        2, 6, 2, 8, 3, 3, 5, 5, 2, 2, 2, 2, 4, 4, 6, 6,
+        2, 5, 2, 8, 4, 4, 6, 6, 2, 4, 2, 7, 4, 4, 7, 7
+    };
+
     const std::set<Instruction> group_1A {ADC, AND, CMP, EOR, LDA, ORA, SBC, STA};
     const std::set<Instruction> group_1B {ASL, LDX, LDY, LSR, ROL, ROR};
     const std::set<Instruction> group_2A {DEC, INC, STX, STY};
@@ -96,9 +135,20 @@ public:
     uint16_t merge_uint8_t(uint8_t upper, uint8_t lower); // Combine upper and lower into one uint16_t
 
     void initialize(); // Set all registers and entire memory to 0
-    void write_data_to_memory(uint8_t* data, uint16_t start, uint16_t size); // Write array of bytes to memory
+    void write_data_to_memory(const uint8_t* data, uint16_t start, uint16_t size); // Write array of bytes to memory
+
+    uint8_t execute_next_instruction(); // Determine type of instruction and execute said instruction, returns the cycles taken
+    void request_nmi() { nmi_pending = true; } // Service an NMI before the next instruction
+    void reset(); // Restart from the reset vector, as when the reset button is pressed
+    void set_irq_line(bool asserted) { irq_line = asserted; }
+
+    uint64_t get_cycles() { return cycles; }
+
+    void attach_profiler(Profiler* profiler_ptr) { this->profiler = profiler_ptr; }
+    void profile_cycles(uint32_t cycles_taken) { if (profiler) profiler->add_cycles(cycles_taken); } // Includes cycles stalled by DMA
 
-    void execute_next_instruction(); // Determine type of instruction and execute said instruction
+    void save_state(CPUState& state);
+    void load_state(const CPUState& state);
 
     uint8_t next_prg_byte(); // Read the next byte from the program code
 };
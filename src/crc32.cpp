@@ -0,0 +1,173 @@
+#include "crc32.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_CLMUL
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define CRC32_POLYNOMIAL 0xEDB88320
+#define CLMUL_MIN_SIZE 64 // Folding needs at least 4 blocks of 16 bytes
+
+// Slice-by-8: table k gives the CRC of a byte followed by k zero bytes, so 8 bytes are folded in with 8 lookups
+struct CRC32Tables {
+    uint32_t table[8][256];
+
+    constexpr CRC32Tables() : table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (crc & 1 ? CRC32_POLYNOMIAL : 0);
+            }
+            table[0][i] = crc;
+        }
+
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static constexpr CRC32Tables tables;
+
+// Works on the inverted CRC, like the folding below
+static uint32_t crc32_slice_by_8(const uint8_t* data, size_t size, uint32_t crc) {
+    const uint32_t (*table)[256] = tables.table;
+
+    while (size >= 8) {
+        uint32_t low;
+        uint32_t high;
+        memcpy(&low, data, 4);
+        memcpy(&high, data + 4, 4);
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^ table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+
+        data += 8;
+        size -= 8;
+    }
+
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+    }
+
+    return crc;
+}
+
+#ifdef CRC32_CLMUL
+// Folds 64 bytes at a time with carry-less multiplication, after "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction" (Intel, 2009). The constants are powers of x modulo the polynomial, bit reflected.
+// Takes the inverted CRC and a size of at least CLMUL_MIN_SIZE that is a multiple of 16.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_clmul(const uint8_t* data, size_t size, uint32_t crc) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4); // x^(4*128+32), x^(4*128-32)
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0); // x^(128+32), x^(128-32)
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163CD6124); // x^64
+    const __m128i poly_mu = _mm_set_epi64x(0x01F7011641, 0x01DB710641); // Barrett reduction: mu and P(x)
+    const __m128i low_32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i*) (data + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i*) (data + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i*) (data + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i*) (data + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    data += 64;
+    size -= 64;
+
+    // Four independent lanes keep the multipliers busy
+    while (size >= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*) (data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*) (data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*) (data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*) (data + 0x30)));
+
+        data += 64;
+        size -= 64;
+    }
+
+    // Fold the four lanes into one
+    __m128i lanes[3] = {x2, x3, x4};
+    for (__m128i lane : lanes) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, lane), x5);
+    }
+
+    while (size >= 16) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*) data)), x5);
+
+        data += 16;
+        size -= 16;
+    }
+
+    // 128 bits down to 64
+    __m128i x2_fold = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2_fold);
+
+    __m128i high = _mm_srli_si128(x1, 4);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, low_32), k5, 0x00);
+    x1 = _mm_xor_si128(x1, high);
+
+    // And the last 64 to 32 with a Barrett reduction
+    __m128i quotient = _mm_clmulepi64_si128(_mm_and_si128(x1, low_32), poly_mu, 0x10);
+    __m128i product = _mm_clmulepi64_si128(_mm_and_si128(quotient, low_32), poly_mu, 0x00);
+    x1 = _mm_xor_si128(x1, product);
+
+    return _mm_extract_epi32(x1, 1);
+}
+
+static bool has_clmul() {
+    static bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    return supported;
+}
+#endif
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    const uint8_t* position = (const uint8_t*) data;
+    crc = ~crc;
+
+#if defined(CRC32_CLMUL)
+    if (size >= CLMUL_MIN_SIZE && has_clmul()) {
+        size_t folded = size & ~(size_t) 15;
+        crc = crc32_clmul(position, folded, crc);
+        position += folded;
+        size -= folded;
+    }
+#elif defined(__ARM_FEATURE_CRC32)
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, position, 8);
+        crc = __crc32d(crc, value);
+        position += 8;
+        size -= 8;
+    }
+#endif
+
+    return ~crc32_slice_by_8(position, size, crc);
+}
@@ -0,0 +1,12 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32 as used by zip and by ROM databases (reflected polynomial 0xEDB88320). Pass the result of the previous
+// call as crc to continue over several blocks. Uses carry-less multiplication on x86 and the CRC instructions on
+// ARMv8 when the CPU has them, and slice-by-8 tables otherwise; either way a 1 MB ROM takes well under a millisecond.
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+#endif
@@ -0,0 +1,209 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+
+#include "cartridge.h"
+#include "code_data_logger.h"
+#include "disassembler.h"
+
+#define DATA_BYTES_PER_LINE 8
+#define VECTORS_OFFSET 0x3FFA // NMI, reset and IRQ vectors at the end of the bank mapped at $C000
+
+static std::string hex(uint32_t value, int digits) {
+    char text[16];
+    snprintf(text, sizeof(text), "%0*X", digits, value);
+    return text;
+}
+
+// Annotated listing of one 16 KB PRG-ROM bank. With a CDL only bytes logged as opcodes are decoded and the rest is
+// shown as data or skipped; without one the whole bank is decoded as a linear sweep.
+static void disassemble_bank(std::ostream& output, const uint8_t* bank, const uint8_t* flags, uint16_t base, bool has_vectors) {
+    std::vector<bool> is_instruction(PRG_ROM_BANK_SIZE, false);
+    std::vector<std::string> labels(PRG_ROM_BANK_SIZE);
+
+    uint32_t vectors_start = has_vectors ? VECTORS_OFFSET : PRG_ROM_BANK_SIZE;
+
+    // Find where instructions start
+    for (uint32_t i = 0; i < vectors_start; ) {
+        if (flags) {
+            is_instruction[i] = flags[i] & CDL_OPCODE;
+            i++;
+        } else {
+            is_instruction[i] = true;
+            i += get_instruction_length(bank[i]);
+        }
+    }
+
+    // Label every jump target inside this bank that is the start of an instruction
+    for (uint32_t i = 0; i < vectors_start; i++) {
+        uint16_t target;
+
+        if (is_instruction[i] && i + get_instruction_length(bank[i]) <= vectors_start && get_jump_target(bank + i, base + i, target)) {
+            // Targets below the bank wrap around to far past its end
+            uint32_t offset = (uint16_t) (target - base);
+
+            if (offset < vectors_start && is_instruction[offset]) {
+                labels[offset] = "L" + hex(target, 4);
+            }
+        }
+    }
+
+    if (has_vectors) {
+        const char* names[] = {"NMI", "RESET", "IRQ"};
+
+        for (int i = 0; i < 3; i++) {
+            uint16_t target = bank[VECTORS_OFFSET + i * 2] | (bank[VECTORS_OFFSET + i * 2 + 1] << 8);
+            uint32_t offset = (uint16_t) (target - base);
+
+            if (offset < vectors_start) {
+                labels[offset] = names[i];
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < vectors_start; ) {
+        if (!labels[i].empty()) {
+            output << labels[i] << ":" << std::endl;
+        }
+
+        uint8_t length = get_instruction_length(bank[i]);
+
+        if (is_instruction[i] && i + length <= vectors_start) {
+            std::string bytes;
+            for (uint8_t j = 0; j < length; j++) {
+                bytes += hex(bank[i + j], 2) + " ";
+            }
+
+            // Use the label for jumps that have one
+            std::string label;
+            uint16_t target;
+            if (get_jump_target(bank + i, base + i, target) && (uint16_t) (target - base) < vectors_start) {
+                label = labels[(uint16_t) (target - base)];
+            }
+
+            std::string text = disassemble_instruction(bank + i, base + i, label);
+            output << "    " << hex(base + i, 4) << "  " << bytes << std::string(10 - bytes.size(), ' ') << text;
+
+            if (flags && (flags[i] & CDL_DATA)) {
+                output << std::string(text.size() < 20 ? 20 - text.size() : 1, ' ') << "; also read as data";
+            }
+
+            output << std::endl;
+            i += length;
+            continue;
+        }
+
+        uint8_t usage = flags ? flags[i] : CDL_DATA;
+
+        if (usage == 0) {
+            // Never touched, collapse the whole run
+            uint32_t end = i + 1;
+            while (end < vectors_start && flags[end] == 0 && labels[end].empty()) {
+                end++;
+            }
+
+            output << "    ; " << hex(base + i, 4) << "-" << hex(base + end - 1, 4) << ": " << end - i << " bytes never used" << std::endl;
+            i = end;
+            continue;
+        }
+
+        // Data, or operand bytes whose opcode was never logged
+        uint32_t end = i + 1;
+        while (end < vectors_start && end - i < DATA_BYTES_PER_LINE && !is_instruction[end] && (flags ? flags[end] : CDL_DATA) == usage &&
+               labels[end].empty()) {
+            end++;
+        }
+
+        output << "    " << hex(base + i, 4) << "  .byte ";
+        for (uint32_t j = i; j < end; j++) {
+            output << "$" << hex(bank[j], 2) << (j + 1 < end ? "," : "");
+        }
+        if (flags) {
+            output << "  ; " << (usage & CDL_DATA ? "data" : "operand");
+        }
+        output << std::endl;
+
+        i = end;
+    }
+
+    if (has_vectors) {
+        output << "    " << hex(base + VECTORS_OFFSET, 4) << "  .word NMI, RESET, IRQ" << std::endl;
+    }
+}
+
+// Writes annotated assembly for the PRG-ROM of a ROM, using a Code/Data Logger file to tell code from data
+int main(int argc, char **argv) {
+    // Usage: NES_disassemble <rom> [--cdl path] [--output path]
+    const char* rom_path = nullptr;
+    const char* cdl_path = nullptr;
+    const char* output_path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cdl") == 0 && i + 1 < argc) {
+            cdl_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else {
+            rom_path = argv[i];
+        }
+    }
+
+    if (!rom_path) {
+        std::cerr << "Usage: " << argv[0] << " <rom> [--cdl path] [--output path]" << std::endl;
+        return 2;
+    }
+
+    std::ifstream input(rom_path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    // The cartridge logs to stdout, which may be carrying the listing
+    std::cout.setstate(std::ios::failbit);
+    Cartridge cartridge = Cartridge(data.data(), data.size());
+    std::cout.clear();
+
+    if (!cartridge.is_valid_header() || cartridge.get_nr_prg_rom_banks() == 0 || data.size() < cartridge.get_rom_size()) {
+        std::cerr << "Invalid ROM " << rom_path << (cartridge.get_error().empty() ? "" : ": " + cartridge.get_error()) << std::endl;
+        return 1;
+    }
+
+    uint32_t prg_rom_size = cartridge.get_nr_prg_rom_banks() * PRG_ROM_BANK_SIZE;
+    const uint8_t* prg_rom = data.data() + INES_HEADER_SIZE + (cartridge.has_trainer() ? TRAINER_SIZE : 0);
+
+    CodeDataLogger cdl = CodeDataLogger(prg_rom_size);
+    if (cdl_path && !cdl.load(cdl_path)) {
+        return 1;
+    }
+
+    std::ofstream output_file;
+    if (output_path) {
+        output_file.open(output_path);
+    }
+    std::ostream& output = output_path ? output_file : std::cout;
+
+    output << "; " << rom_path << ": " << (int) cartridge.get_nr_prg_rom_banks() << " PRG-ROM banks, mapper " << (int) cartridge.get_mapper_number() << std::endl;
+
+    if (cdl_path) {
+        uint32_t unused = prg_rom_size - cdl.count(CDL_OPCODE | CDL_OPERAND | CDL_DATA);
+        output << "; " << cdl.count(CDL_OPCODE) << " opcode, " << cdl.count(CDL_OPERAND) << " operand and " << cdl.count(CDL_DATA) << " data bytes logged, "
+               << unused * 100 / prg_rom_size << "% never used" << std::endl;
+    } else {
+        output << "; No CDL given, everything is decoded as code" << std::endl;
+    }
+
+    for (uint16_t bank = 0; bank < cartridge.get_nr_prg_rom_banks(); bank++) {
+        // Switchable banks are shown at $8000, the bank fixed at $C000 holds the vectors
+        bool is_upper = bank == cartridge.get_prg_bank(1);
+        uint16_t base = is_upper ? 0xC000 : 0x8000;
+
+        output << std::endl << "; Bank " << (int) bank << " at $" << hex(base, 4) << ", ROM offset $" << hex(prg_rom + bank * PRG_ROM_BANK_SIZE - data.data(), 5) << std::endl;
+        output << "    .org $" << hex(base, 4) << std::endl;
+
+        disassemble_bank(output, prg_rom + bank * PRG_ROM_BANK_SIZE, cdl_path ? cdl.get_flags() + bank * PRG_ROM_BANK_SIZE : nullptr, base, is_upper);
+    }
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "disassembler.h"
+
+#include <cstdio>
+
+static const OpcodeInfo opcode_table[256] = {
+    // $00
+    {"BRK", Implied}, {"ORA", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"ORA", ZeroPage}, {"ASL", ZeroPage}, {"???", Unofficial},
+    {"PHP", Implied}, {"ORA", Immediate}, {"ASL", Accumulator}, {"???", Unofficial}, {"???", Unofficial}, {"ORA", Absolute}, {"ASL", Absolute}, {"???", Unofficial},
+    // $10
+    {"BPL", Relative}, {"ORA", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"ORA", ZeroPageX}, {"ASL", ZeroPageX}, {"???", Unofficial},
+    {"CLC", Implied}, {"ORA", AbsoluteY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"ORA", AbsoluteX}, {"ASL", AbsoluteX}, {"???", Unofficial},
+    // $20
+    {"JSR", Absolute}, {"AND", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"BIT", ZeroPage}, {"AND", ZeroPage}, {"ROL", ZeroPage}, {"???", Unofficial},
+    {"PLP", Implied}, {"AND", Immediate}, {"ROL", Accumulator}, {"???", Unofficial}, {"BIT", Absolute}, {"AND", Absolute}, {"ROL", Absolute}, {"???", Unofficial},
+    // $30
+    {"BMI", Relative}, {"AND", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"AND", ZeroPageX}, {"ROL", ZeroPageX}, {"???", Unofficial},
+    {"SEC", Implied}, {"AND", AbsoluteY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"AND", AbsoluteX}, {"ROL", AbsoluteX}, {"???", Unofficial},
+    // $40
+    {"RTI", Implied}, {"EOR", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"EOR", ZeroPage}, {"LSR", ZeroPage}, {"???", Unofficial},
+    {"PHA", Implied}, {"EOR", Immediate}, {"LSR", Accumulator}, {"???", Unofficial}, {"JMP", Absolute}, {"EOR", Absolute}, {"LSR", Absolute}, {"???", Unofficial},
+    // $50
+    {"BVC", Relative}, {"EOR", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"EOR", ZeroPageX}, {"LSR", ZeroPageX}, {"???", Unofficial},
+    {"CLI", Implied}, {"EOR", AbsoluteY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"EOR", AbsoluteX}, {"LSR", AbsoluteX}, {"???", Unofficial},
+    // $60
+    {"RTS", Implied}, {"ADC", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"ADC", ZeroPage}, {"ROR", ZeroPage}, {"???", Unofficial},
+    {"PLA", Implied}, {"ADC", Immediate}, {"ROR", Accumulator}, {"???", Unofficial}, {"JMP", Indirect}, {"ADC", Absolute}, {"ROR", Absolute}, {"???", Unofficial},
+    // $70
+    {"BVS", Relative}, {"ADC", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"ADC", ZeroPageX}, {"ROR", ZeroPageX}, {"???", Unofficial},
+    {"SEI", Implied}, {"ADC", AbsoluteY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"ADC", AbsoluteX}, {"ROR", AbsoluteX}, {"???", Unofficial},
+    // $80
+    {"???", Unofficial}, {"STA", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"STY", ZeroPage}, {"STA", ZeroPage}, {"STX", ZeroPage}, {"???", Unofficial},
+    {"DEY", Implied}, {"???", Unofficial}, {"TXA", Implied}, {"???", Unofficial}, {"STY", Absolute}, {"STA", Absolute}, {"STX", Absolute}, {"???", Unofficial},
+    // $90
+    {"BCC", Relative}, {"STA", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"STY", ZeroPageX}, {"STA", ZeroPageX}, {"STX", ZeroPageY}, {"???", Unofficial},
+    {"TYA", Implied}, {"STA", AbsoluteY}, {"TXS", Implied}, {"???", Unofficial}, {"???", Unofficial}, {"STA", AbsoluteX}, {"???", Unofficial}, {"???", Unofficial},
+    // $A0
+    {"LDY", Immediate}, {"LDA", IndirectX}, {"LDX", Immediate}, {"???", Unofficial}, {"LDY", ZeroPage}, {"LDA", ZeroPage}, {"LDX", ZeroPage}, {"???", Unofficial},
+    {"TAY", Implied}, {"LDA", Immediate}, {"TAX", Implied}, {"???", Unofficial}, {"LDY", Absolute}, {"LDA", Absolute}, {"LDX", Absolute}, {"???", Unofficial},
+    // $B0
+    {"BCS", Relative}, {"LDA", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"LDY", ZeroPageX}, {"LDA", ZeroPageX}, {"LDX", ZeroPageY}, {"???", Unofficial},
+    {"CLV", Implied}, {"LDA", AbsoluteY}, {"TSX", Implied}, {"???", Unofficial}, {"LDY", AbsoluteX}, {"LDA", AbsoluteX}, {"LDX", AbsoluteY}, {"???", Unofficial},
+    // $C0
+    {"CPY", Immediate}, {"CMP", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"CPY", ZeroPage}, {"CMP", ZeroPage}, {"DEC", ZeroPage}, {"???", Unofficial},
+    {"INY", Implied}, {"CMP", Immediate}, {"DEX", Implied}, {"???", Unofficial}, {"CPY", Absolute}, {"CMP", Absolute}, {"DEC", Absolute}, {"???", Unofficial},
+    // $D0
+    {"BNE", Relative}, {"CMP", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"CMP", ZeroPageX}, {"DEC", ZeroPageX}, {"???", Unofficial},
+    {"CLD", Implied}, {"CMP", AbsoluteY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"CMP", AbsoluteX}, {"DEC", AbsoluteX}, {"???", Unofficial},
+    // $E0
+    {"CPX", Immediate}, {"SBC", IndirectX}, {"???", Unofficial}, {"???", Unofficial}, {"CPX", ZeroPage}, {"SBC", ZeroPage}, {"INC", ZeroPage}, {"???", Unofficial},
+    {"INX", Implied}, {"SBC", Immediate}, {"NOP", Implied}, {"???", Unofficial}, {"CPX", Absolute}, {"SBC", Absolute}, {"INC", Absolute}, {"???", Unofficial},
+    // $F0
+    {"BEQ", Relative}, {"SBC", IndirectY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"SBC", ZeroPageX}, {"INC", ZeroPageX}, {"???", Unofficial},
+    {"SED", Implied}, {"SBC", AbsoluteY}, {"???", Unofficial}, {"???", Unofficial}, {"???", Unofficial}, {"SBC", AbsoluteX}, {"INC", AbsoluteX}, {"???", Unofficial}
+};
+
+// Bytes taken by each addressing mode, including the opcode
+static const uint8_t mode_lengths[] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 2, 2, 2, 1};
+
+const OpcodeInfo& get_opcode_info(uint8_t opcode) {
+    return opcode_table[opcode];
+}
+
+uint8_t get_instruction_length(uint8_t opcode) {
+    return mode_lengths[opcode_table[opcode].mode];
+}
+
+bool get_jump_target(const uint8_t* instruction, uint16_t address, uint16_t& target) {
+    const OpcodeInfo& info = opcode_table[instruction[0]];
+
+    if (info.mode == Relative) {
+        target = address + 2 + (int8_t) instruction[1];
+        return true;
+    }
+
+    // JMP and JSR absolute
+    if (instruction[0] == 0x4C || instruction[0] == 0x20) {
+        target = instruction[1] | (instruction[2] << 8);
+        return true;
+    }
+
+    return false;
+}
+
+std::string disassemble_instruction(const uint8_t* instruction, uint16_t address, const std::string& label) {
+    const OpcodeInfo& info = opcode_table[instruction[0]];
+    uint8_t length = get_instruction_length(instruction[0]);
+    char text[32];
+
+    // Only the bytes that belong to the instruction are read, it may be the last one in the buffer
+    uint16_t operand = 0;
+    if (length == 3) {
+        operand = instruction[1] | (instruction[2] << 8);
+    } else if (length == 2) {
+        operand = instruction[1];
+    }
+
+    uint16_t target;
+    if (!label.empty() && get_jump_target(instruction, address, target)) {
+        return std::string(info.mnemonic) + " " + label;
+    }
+
+    switch (info.mode) {
+        case Implied: { snprintf(text, sizeof(text), "%s", info.mnemonic); break; }
+        case Accumulator: { snprintf(text, sizeof(text), "%s A", info.mnemonic); break; }
+        case Immediate: { snprintf(text, sizeof(text), "%s #$%02X", info.mnemonic, operand); break; }
+        case ZeroPage: { snprintf(text, sizeof(text), "%s $%02X", info.mnemonic, operand); break; }
+        case ZeroPageX: { snprintf(text, sizeof(text), "%s $%02X,X", info.mnemonic, operand); break; }
+        case ZeroPageY: { snprintf(text, sizeof(text), "%s $%02X,Y", info.mnemonic, operand); break; }
+        case Absolute: { snprintf(text, sizeof(text), "%s $%04X", info.mnemonic, operand); break; }
+        case AbsoluteX: { snprintf(text, sizeof(text), "%s $%04X,X", info.mnemonic, operand); break; }
+        case AbsoluteY: { snprintf(text, sizeof(text), "%s $%04X,Y", info.mnemonic, operand); break; }
+        case Indirect: { snprintf(text, sizeof(text), "%s ($%04X)", info.mnemonic, operand); break; }
+        case IndirectX: { snprintf(text, sizeof(text), "%s ($%02X,X)", info.mnemonic, operand); break; }
+        case IndirectY: { snprintf(text, sizeof(text), "%s ($%02X),Y", info.mnemonic, operand); break; }
+        case Relative: { snprintf(text, sizeof(text), "%s $%04X", info.mnemonic, (uint16_t) (address + 2 + (int8_t) operand)); break; }
+        default: { snprintf(text, sizeof(text), ".byte $%02X", instruction[0]); break; }
+    }
+
+    return text;
+}
@@ -0,0 +1,28 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdint.h>
+#include <string>
+
+enum AddressingMode {
+    Implied, Accumulator, Immediate, ZeroPage, ZeroPageX, ZeroPageY, Absolute, AbsoluteX, AbsoluteY,
+    Indirect, IndirectX, IndirectY, Relative, Unofficial
+};
+
+struct OpcodeInfo {
+    const char* mnemonic;
+    AddressingMode mode;
+};
+
+// Table-driven 6502 disassembly; unofficial opcodes come out as a single .byte
+const OpcodeInfo& get_opcode_info(uint8_t opcode);
+uint8_t get_instruction_length(uint8_t opcode);
+
+// Where a branch, JMP or JSR at address goes; false for every other instruction and for JMP ($xxxx)
+bool get_jump_target(const uint8_t* instruction, uint16_t address, uint16_t& target);
+
+// Formats the instruction at address, e.g. "LDA $0300,X"; instruction must hold get_instruction_length() bytes.
+// Jump targets are replaced by label when one is given.
+std::string disassemble_instruction(const uint8_t* instruction, uint16_t address, const std::string& label = "");
+
+#endif
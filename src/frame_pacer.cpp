@@ -0,0 +1,37 @@
+#include "frame_pacer.h"
+
+FramePacer::FramePacer(double frame_rate) {
+    set_frame_rate(frame_rate);
+    reset();
+}
+
+FramePacer::~FramePacer() {}
+
+void FramePacer::reset() {
+    deadline = std::chrono::steady_clock::now();
+}
+
+void FramePacer::set_frame_rate(double frame_rate) {
+    frame_time = std::chrono::nanoseconds((int64_t) (1e9 / frame_rate));
+}
+
+void FramePacer::wait() {
+    // Deadlines are absolute, so the error of one frame doesn't add up over the next ones
+    deadline += frame_time;
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (now > deadline + frame_time) {
+        // More than a frame behind, e.g. after the window was dragged; don't try to catch up in a burst
+        deadline = now;
+        return;
+    }
+
+    if (deadline - now > SPIN_MARGIN) {
+        std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+    }
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        // Spin out the last stretch, the scheduler is too coarse for it
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <thread>
+
+#define NTSC_FRAME_RATE 60.0988 // 1789773 Hz / 29780.5 cycles per frame
+#define SPIN_MARGIN std::chrono::microseconds(1500) // Sleeping is only trusted up to this close to the deadline
+
+// Keeps the main loop at the NES frame rate by sleeping and then spinning to a high resolution deadline
+class FramePacer {
+private:
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::nanoseconds frame_time;
+public:
+    FramePacer(double frame_rate);
+    ~FramePacer();
+
+    void reset(); // Start pacing from now
+    void set_frame_rate(double frame_rate);
+    void wait(); // Block until the next frame is due
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "hash.h"
+
+#include <cstring>
+
+#define PRIME_1 0x9E3779B185EBCA87ULL
+#define PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME_3 0x165667B19E3779F9ULL
+#define PRIME_4 0x85EBCA77C2B2AE63ULL
+#define PRIME_5 0x27D4EB2F165667C5ULL
+#define STRIPE_SIZE 32
+
+static inline uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read_64(const uint8_t* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read_32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint64_t round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME_2;
+    return rotate_left(accumulator, 31) * PRIME_1;
+}
+
+static inline uint64_t merge_round(uint64_t hash, uint64_t accumulator) {
+    hash ^= round(0, accumulator);
+    return hash * PRIME_1 + PRIME_4;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* position = (const uint8_t*) data;
+    const uint8_t* end = position + size;
+    uint64_t hash;
+
+    if (size >= STRIPE_SIZE) {
+        // Four independent lanes keep the multipliers busy
+        uint64_t lanes[4] = {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1};
+
+        for (; position + STRIPE_SIZE <= end; position += STRIPE_SIZE) {
+            lanes[0] = round(lanes[0], read_64(position));
+            lanes[1] = round(lanes[1], read_64(position + 8));
+            lanes[2] = round(lanes[2], read_64(position + 16));
+            lanes[3] = round(lanes[3], read_64(position + 24));
+        }
+
+        hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18);
+
+        for (int i = 0; i < 4; i++) {
+            hash = merge_round(hash, lanes[i]);
+        }
+    } else {
+        hash = seed + PRIME_5;
+    }
+
+    hash += size;
+
+    // Whatever is left over of the last stripe
+    for (; position + 8 <= end; position += 8) {
+        hash ^= round(0, read_64(position));
+        hash = rotate_left(hash, 27) * PRIME_1 + PRIME_4;
+    }
+
+    if (position + 4 <= end) {
+        hash ^= read_32(position) * PRIME_1;
+        hash = rotate_left(hash, 23) * PRIME_2 + PRIME_3;
+        position += 4;
+    }
+
+    for (; position < end; position++) {
+        hash ^= *position * PRIME_5;
+        hash = rotate_left(hash, 11) * PRIME_1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,11 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 64-bit xxHash (XXH64) of a block of memory. Not cryptographic, but fast enough (several GB/s)
+// to fingerprint whole frames and RAM every frame, and stable across runs and platforms.
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+#endif
@@ -0,0 +1,192 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <stdint.h>
+
+#include "nes.h"
+#include "video_capture.h"
+#include "movie.h"
+#include "instrumentation.h"
+
+// Runs a ROM without a window, for test runs and capturing gameplay
+int main(int argc, char **argv) {
+    // Usage: NES_headless <rom> [--frames n] [--frame-skip n] [--play movie] [--capture path] [--capture-raw] [--capture-block] [--cdl path] [--profile path] [--profile-interval n] [--zones path] [--db path]
+    const char* rom_path = nullptr;
+    const char* capture_path = nullptr;
+    const char* movie_path = nullptr;
+    const char* cdl_path = nullptr;
+    const char* profile_path = nullptr;
+    const char* zones_path = nullptr;
+    const char* database_path = nullptr;
+    uint32_t profile_interval = PROFILER_DEFAULT_INTERVAL;
+    uint64_t nr_of_frames = 600;
+    bool frames_given = false;
+    int frame_skip = 0;
+    CaptureFormat capture_format = Y4M;
+    CapturePolicy capture_policy = DropFrames;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            nr_of_frames = strtoull(argv[++i], nullptr, 10);
+            frames_given = true;
+        } else if (strcmp(argv[i], "--frame-skip") == 0 && i + 1 < argc) {
+            frame_skip = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            movie_path = argv[++i];
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (strcmp(argv[i], "--cdl") == 0 && i + 1 < argc) {
+            // Log code and data usage, merged into the file if it already exists
+            cdl_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            // Folded call stacks of the game, for flamegraph.pl and the like
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile-interval") == 0 && i + 1 < argc) {
+            profile_interval = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--zones") == 0 && i + 1 < argc) {
+            // Chrome trace of the instrumentation zones, in builds with NES_INSTRUMENTATION
+            zones_path = argv[++i];
+        } else if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            // Correct the headers of known ROMs, see NES_romdb
+            database_path = argv[++i];
+        } else if (strcmp(argv[i], "--capture-raw") == 0) {
+            capture_format = RawRGB;
+        } else if (strcmp(argv[i], "--capture-block") == 0) {
+            // Never drop frames, slow emulation down to the speed of the reader instead
+            capture_policy = Backpressure;
+        } else {
+            rom_path = argv[i];
+        }
+    }
+
+    if (!rom_path) {
+        std::cout << "Usage: " << argv[0] << " <rom> [--frames n] [--frame-skip n] [--play movie] [--capture path] [--capture-raw] [--capture-block] [--cdl path] [--profile path] [--profile-interval n] [--zones path] [--db path]" << std::endl;
+        return 2;
+    }
+
+    // A reader closing its end of the pipe should stop the capture, not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    int capture_fd = -1;
+
+    if (capture_path && strcmp(capture_path, "-") == 0) {
+        // The core logs to stdout, so keep the real stdout for the capture and send the logging to stderr
+        capture_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    NES* nes = new NES();
+    nes->set_frame_skip(frame_skip);
+
+    RomDatabase database;
+    if (database_path) {
+        if (!database.load(database_path)) {
+            delete nes;
+            return 1;
+        }
+
+        nes->set_rom_database(&database);
+    }
+
+    if (!nes->load_rom(rom_path)) {
+        delete nes;
+        return 2;
+    }
+
+    if (cdl_path) {
+        nes->set_code_data_logging(true);
+
+        std::ifstream existing(cdl_path);
+        if (existing && !nes->get_code_data_logger()->load(cdl_path)) {
+            delete nes;
+            return 1;
+        }
+    }
+
+    if (profile_path) {
+        nes->set_profiling(true, profile_interval);
+    }
+
+    Movie* movie = nullptr;
+
+    if (movie_path) {
+        movie = new Movie();
+
+        if (!movie->load(movie_path)) {
+            delete movie;
+            delete nes;
+            return 1;
+        }
+
+        if (!frames_given) {
+            nr_of_frames = movie->get_nr_of_frames();
+        }
+    }
+
+    VideoCapture* capture = nullptr;
+
+    if (capture_path) {
+        capture = new VideoCapture(capture_format, capture_policy);
+
+        bool opened = capture_fd >= 0 ? capture->open_fd(capture_fd) : capture->open(capture_path);
+
+        if (!opened) {
+            delete capture;
+            delete nes;
+            return 1;
+        }
+    }
+
+    ZONE_THREAD_NAME("emulation");
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t frame = 0; frame < nr_of_frames; frame++) {
+        if (movie && !movie->is_finished()) {
+            // Input is applied at the start of the frame, exactly where it was recorded
+            nes->set_controller_state(movie->next_frame());
+        }
+
+        nes->run_frame();
+
+        if (capture && nes->is_frame_rendered()) {
+            capture->submit(nes->get_frame_buffer()->get_latest());
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Progress goes to stderr, stdout may be carrying the capture
+    std::cerr << nr_of_frames << " frames in " << seconds << " s (" << nr_of_frames / seconds << " fps)" << std::endl;
+
+    if (capture) {
+        capture->close();
+        std::cerr << "Captured " << capture->get_frames_written() << " frames, dropped " << capture->get_frames_dropped() << std::endl;
+        delete capture;
+    }
+
+    if (cdl_path) {
+        CodeDataLogger* cdl = nes->get_code_data_logger();
+        cdl->save(cdl_path);
+        std::cerr << "Logged " << cdl->count(CDL_OPCODE | CDL_OPERAND) << " code and " << cdl->count(CDL_DATA) << " data bytes out of " << cdl->get_size() << std::endl;
+    }
+
+    if (profile_path) {
+        Profiler* profiler = nes->get_profiler();
+        profiler->write_folded(profile_path);
+        profiler->print_summary(std::cerr, 10);
+    }
+
+    if (zones_path) {
+#ifndef NES_INSTRUMENTATION
+        std::cerr << "Built without NES_INSTRUMENTATION, the zone trace is empty" << std::endl;
+#endif
+        write_zone_trace(zones_path);
+    }
+
+    delete movie;
+    delete nes;
+
+    return 0;
+}
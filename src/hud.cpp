@@ -0,0 +1,72 @@
+#include "hud.h"
+
+Hud::Hud() {
+    visible.store(false);
+}
+
+Hud::~Hud() {}
+
+void Hud::set_text(const std::string& new_text) {
+    std::lock_guard<std::mutex> guard(lock);
+    text = new_text;
+}
+
+const char* Hud::find_glyph(char character) {
+    if (character >= 'a' && character <= 'z') {
+        character -= 'a' - 'A';
+    }
+
+    for (const Glyph& glyph : font) {
+        if (glyph.character == character) {
+            return glyph.pixels;
+        }
+    }
+
+    return nullptr;
+}
+
+void Hud::draw(SDL_Renderer* renderer, int scale) {
+    if (!visible.load()) {
+        return;
+    }
+
+    // Keep showing the previous text rather than waiting while it's being replaced
+    if (lock.try_lock()) {
+        drawn_text = text;
+        lock.unlock();
+    }
+
+    rects.clear();
+
+    int x = HUD_MARGIN;
+    int y = HUD_MARGIN;
+    int width = 0;
+
+    for (char character : drawn_text) {
+        if (character == '\n') {
+            x = HUD_MARGIN;
+            y += GLYPH_HEIGHT + 1;
+            continue;
+        }
+
+        const char* pixels = find_glyph(character);
+
+        for (int i = 0; pixels && i < GLYPH_WIDTH * GLYPH_HEIGHT; i++) {
+            if (pixels[i] == '1') {
+                rects.push_back({(x + i % GLYPH_WIDTH) * scale, (y + i / GLYPH_WIDTH) * scale, scale, scale});
+            }
+        }
+
+        x += GLYPH_WIDTH + 1;
+        width = std::max(width, x);
+    }
+
+    // Darken the frame behind the text so it stays readable
+    SDL_Rect background = {0, 0, (width + HUD_MARGIN) * scale, (y + GLYPH_HEIGHT + HUD_MARGIN) * scale};
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xA0);
+    SDL_RenderFillRect(renderer, &background);
+
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderFillRects(renderer, rects.data(), rects.size());
+}
@@ -0,0 +1,58 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#include "SDL2/SDL.h"
+
+#define GLYPH_WIDTH 3
+#define GLYPH_HEIGHT 5
+#define HUD_MARGIN 2
+
+// Performance overlay, drawn with a tiny built-in font on top of each presented frame.
+// The text is set from the emulation thread and drawn on the main thread, which presents.
+class Hud {
+private:
+    struct Glyph {
+        char character;
+        const char* pixels; // Rows from top to bottom, '1' is lit
+    };
+    constexpr static Glyph font[] = {
+        {'0', "111101101101111"}, {'1', "010110010010111"}, {'2', "111001111100111"}, {'3', "111001111001111"},
+        {'4', "101101111001001"}, {'5', "111100111001111"}, {'6', "111100111101111"}, {'7', "111001001001001"},
+        {'8', "111101111101111"}, {'9', "111101111001111"}, {'A', "010101111101101"}, {'B', "110101110101110"},
+        {'C', "011100100100011"}, {'D', "110101101101110"}, {'E', "111100110100111"}, {'F', "111100110100100"},
+        {'G', "011100101101011"}, {'H', "101101111101101"}, {'I', "111010010010111"}, {'J', "001001001101010"},
+        {'K', "101101110101101"}, {'L', "100100100100111"}, {'M', "101111111101101"}, {'N', "110101101101101"},
+        {'O', "010101101101010"}, {'P', "110101110100100"}, {'Q', "010101101110011"}, {'R', "110101110101101"},
+        {'S', "011100010001110"}, {'T', "111010010010010"}, {'U', "101101101101111"}, {'V', "101101101101010"},
+        {'W', "101101111111101"}, {'X', "101101010101101"}, {'Y', "101101010010010"}, {'Z', "111001010100111"},
+        {'.', "000000000000010"}, {':', "000010000010000"}, {'%', "101001010100101"}, {'/', "001001010100100"},
+        {'-', "000000111000000"}, {'(', "001010010010001"}, {')', "100010010010100"}
+    };
+
+    std::mutex lock; // Only held to swap the text, the presenter never waits for it
+    std::string text;
+    std::string drawn_text;
+    std::atomic<bool> visible;
+
+    std::vector<SDL_Rect> rects;
+
+    const char* find_glyph(char character);
+public:
+    Hud();
+    ~Hud();
+
+    void set_text(const std::string& new_text); // Lines separated by '\n'
+    void set_visible(bool show) { visible.store(show); }
+    bool is_visible() { return visible.load(); }
+
+    void draw(SDL_Renderer* renderer, int scale); // On the thread that presents
+};
+
+#endif
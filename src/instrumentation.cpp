@@ -0,0 +1,106 @@
+#include "instrumentation.h"
+
+#include <mutex>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+thread_local constinit ZoneBuffer* current_zone_buffer = nullptr;
+
+// Every thread that ever recorded a zone, in the order they started
+struct ZoneThread {
+    ZoneBuffer* buffer;
+    std::string name;
+};
+
+static std::mutex zone_threads_mutex;
+static std::vector<ZoneThread> zone_threads;
+
+ZoneBuffer::ZoneBuffer() {
+    events = new ZoneEvent[ZONE_BUFFER_SIZE];
+    count.store(0);
+}
+
+ZoneBuffer::~ZoneBuffer() {
+    delete[] events;
+}
+
+ZoneBuffer* create_zone_buffer() {
+    std::lock_guard<std::mutex> lock(zone_threads_mutex);
+
+    // Kept after the thread exits, so worker threads that have been joined still show up in the trace
+    current_zone_buffer = new ZoneBuffer();
+    zone_threads.push_back({current_zone_buffer, "thread " + std::to_string(zone_threads.size() + 1)});
+
+    return current_zone_buffer;
+}
+
+void set_zone_thread_name(const char* name) {
+    ZoneBuffer* buffer = current_zone_buffer ? current_zone_buffer : create_zone_buffer();
+
+    std::lock_guard<std::mutex> lock(zone_threads_mutex);
+    for (ZoneThread& thread : zone_threads) {
+        if (thread.buffer == buffer) {
+            thread.name = name;
+        }
+    }
+}
+
+bool write_zone_trace(const char* path) {
+    std::ofstream output(path);
+    if (!output) {
+        std::cout << "Failed to open " << path << " for the zone trace" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(zone_threads_mutex);
+
+    // Timestamps are written in microseconds since the earliest begin still in a buffer. Zones are recorded when
+    // they end, so that isn't the oldest event: a zone enclosing it began before it.
+    uint64_t first = UINT64_MAX;
+    for (ZoneThread& thread : zone_threads) {
+        uint64_t count = thread.buffer->get_count();
+        uint64_t oldest = count > ZONE_BUFFER_SIZE ? count - ZONE_BUFFER_SIZE : 0;
+
+        for (uint64_t i = oldest; i < count; i++) {
+            first = std::min(first, thread.buffer->get_event(i).begin);
+        }
+    }
+
+    double ticks_per_us = get_timestamp_frequency() / 1000000;
+    bool first_event = true;
+
+    output << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    output.precision(3);
+    output << std::fixed;
+
+    for (size_t tid = 0; tid < zone_threads.size(); tid++) {
+        ZoneThread& thread = zone_threads[tid];
+
+        output << (first_event ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid + 1
+               << ", \"args\": {\"name\": \"" << thread.name << "\"}}";
+        first_event = false;
+
+        uint64_t count = thread.buffer->get_count();
+        uint64_t oldest = count > ZONE_BUFFER_SIZE ? count - ZONE_BUFFER_SIZE : 0;
+
+        for (uint64_t i = oldest; i < count; i++) {
+            const ZoneEvent& event = thread.buffer->get_event(i);
+
+            // Complete events; nesting is worked out by the viewer from the times
+            output << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid + 1
+                   << ", \"ts\": " << (event.begin - first) / ticks_per_us << ", \"dur\": " << (event.end - event.begin) / ticks_per_us << "}";
+        }
+    }
+
+    output << "\n]}\n";
+
+    if (!output) {
+        std::cout << "Failed to write the zone trace " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
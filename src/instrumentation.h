@@ -0,0 +1,73 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#define ZONE_BUFFER_SIZE (1 << 20) // Zones kept per thread, a power of 2; the oldest are overwritten
+
+#include <stdint.h>
+#include <atomic>
+
+#include "stats.h"
+
+// Host-side instrumentation: named zones record their begin and end timestamps into a ring buffer of the thread
+// they ran on, and write_zone_trace exports every buffer as Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Zones only exist in builds with NES_INSTRUMENTATION defined, otherwise the macros compile to nothing.
+
+struct ZoneEvent {
+    const char* name; // Zone names are string literals, only the pointer is stored
+    uint64_t begin;
+    uint64_t end;
+};
+
+class ZoneBuffer {
+private:
+    ZoneEvent* events;
+    std::atomic<uint64_t> count; // Zones ever recorded, the writing thread is the only one to change it
+public:
+    ZoneBuffer();
+    ~ZoneBuffer();
+
+    void add(const char* name, uint64_t begin, uint64_t end) {
+        uint64_t index = count.load(std::memory_order_relaxed);
+        events[index & (ZONE_BUFFER_SIZE - 1)] = {name, begin, end};
+        count.store(index + 1, std::memory_order_release);
+    }
+
+    uint64_t get_count() { return count.load(std::memory_order_acquire); }
+    const ZoneEvent& get_event(uint64_t index) { return events[index & (ZONE_BUFFER_SIZE - 1)]; }
+};
+
+extern thread_local constinit ZoneBuffer* current_zone_buffer;
+ZoneBuffer* create_zone_buffer(); // Registers a buffer for the calling thread, which outlives the thread
+
+inline void record_zone(const char* name, uint64_t begin, uint64_t end) {
+    ZoneBuffer* buffer = current_zone_buffer ? current_zone_buffer : create_zone_buffer();
+    buffer->add(name, begin, end);
+}
+
+// Records the time from construction until it goes out of scope
+class Zone {
+private:
+    const char* name;
+    uint64_t begin;
+public:
+    Zone(const char* zone_name) : name(zone_name), begin(read_timestamp()) {}
+    ~Zone() { record_zone(name, begin, read_timestamp()); }
+};
+
+void set_zone_thread_name(const char* name); // Shown for the calling thread in the trace
+
+// Zones of all threads so far; best done once the instrumented threads are idle, since the oldest zones of a
+// thread that is still running may be overwritten while they are being written out
+bool write_zone_trace(const char* path);
+
+#ifdef NES_INSTRUMENTATION
+#define ZONE_CONCAT_(a, b) a##b
+#define ZONE_CONCAT(a, b) ZONE_CONCAT_(a, b)
+#define ZONE(name) Zone ZONE_CONCAT(zone_, __LINE__)(name)
+#define ZONE_THREAD_NAME(name) set_zone_thread_name(name)
+#else
+#define ZONE(name)
+#define ZONE_THREAD_NAME(name)
+#endif
+
+#endif
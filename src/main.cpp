@@ -1,10 +1,31 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <stdint.h>
 
 #include "SDL2/SDL.h"
 #include "nes.h"
+#include "presenter.h"
+#include "frame_pacer.h"
+#include "movie.h"
+#include "run_ahead.h"
+#include "instrumentation.h"
+#include "turbo.h"
+#include "audio_buffer.h"
+#include "rate_control.h"
+#include "stats.h"
+#include "hud.h"
+
+#define AUDIO_BUFFER_CAPACITY 4096 // Samples, about 85 ms
+#define AUDIO_DEVICE_SAMPLES 512 // Samples per audio callback
+#define HUD_UPDATE_INTERVAL 30 // Frames the HUD averages over
+#define MAIN_WAIT_TIMEOUT 100 // Milliseconds, the main thread wakes at least this often to see if emulation stopped
 
 // Controller keymap
 unsigned int keymap[NR_OF_BUTTONS] = {
@@ -18,76 +39,228 @@ unsigned int keymap[NR_OF_BUTTONS] = {
     SDLK_RIGHT,
 };
 
-int main(int argc, char **argv) {
-    uint8_t a = 160;
-    std::cout << ((uint16_t) a << 4) << std::endl;
-    /*
-    char nes[4] = "NES";
-    char bits[4];
-    bits[0] = 0x4E;
-    bits[1] = 0x45;
-    bits[2] = 0x53;
-    bits[3] = 0x1A;
-    bool test = 1;
-    bool test2 = true;
-    uint8_t z = 0xFA;
-    std::cout << "Hello NES" << std::endl << ("a" > "A") << std::endl;
-    */
-    
-    SDL_Window *window;
+// Runs on SDL's audio thread, so all it does is drain the ring buffer
+void audio_callback(void* userdata, Uint8* stream, int length) {
+    static int16_t last_sample = 0;
 
-    if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
-        std::cout << "Failed to initialize SDL" << std::endl;
-        return 1;
+    AudioBuffer* buffer = (AudioBuffer*) userdata;
+    int16_t* samples = (int16_t*) stream;
+    uint32_t count = length / sizeof(int16_t);
+    uint32_t read = buffer->read(samples, count);
+
+    if (read > 0) {
+        last_sample = samples[read - 1];
     }
 
-    
-    window = SDL_CreateWindow("Nemulator", 
-                               SDL_WINDOWPOS_UNDEFINED,
-                               SDL_WINDOWPOS_UNDEFINED,
-                               FRAME_WIDTH * 8,
-                               FRAME_HEIGHT * 8,
-                               SDL_WINDOW_SHOWN);
+    // Running dry, hold the last level rather than dropping to zero which would click
+    for (uint32_t i = read; i < count; i++) {
+        samples[i] = last_sample;
+    }
+}
 
-    if (!window) {
-        std::cout << "Failed to create window" << std::endl;
+// Everything the emulation thread shares with the main thread. SDL only supports rendering and polling events on
+// the thread that created the window, so the main thread does that and hands input over through here.
+struct Frontend {
+    NES* nes;
+    Presenter* presenter;
+    Hud* hud;
+    AudioBuffer* audio;
+    SDL_AudioDeviceID audio_device;
+    const char* rom_path;
+    const char* movie_path;
+    int frames_ahead;
+    bool vsync;
+    bool audio_sync;
+
+    std::atomic<bool> running;
+    int result; // Exit code, written by the emulation thread before it stops running
+
+    uint32_t frame_event; // Registered SDL event type that wakes the main thread
+    std::atomic<bool> frame_event_pending; // Keeps a fast-forwarding emulation thread from flooding the event queue
+
+    std::mutex lock;
+    std::vector<SDL_Event> events; // Input polled on the main thread
+    std::string title; // Window title to set, empty if unchanged
+};
+
+static void wake_main_thread(Frontend& frontend) {
+    if (!frontend.frame_event_pending.exchange(true)) {
+        SDL_Event event;
+        memset(&event, 0, sizeof(event));
+        event.type = frontend.frame_event;
+
+        // A full queue drops it, the next frame tries again
+        if (SDL_PushEvent(&event) <= 0) {
+            frontend.frame_event_pending.store(false);
+        }
     }
+}
 
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 0);
-    SDL_RenderSetLogicalSize(renderer, FRAME_WIDTH * 8, FRAME_HEIGHT * 8);
+// Runs the emulation loop on its own thread until the user quits
+static void emulate(Frontend& frontend) {
+    NES* nes = frontend.nes;
+    Presenter* presenter = frontend.presenter;
+    Hud* hud = frontend.hud;
+    AudioBuffer* audio = frontend.audio;
+    SDL_AudioDeviceID audio_device = frontend.audio_device;
+    const char* movie_path = frontend.movie_path;
+    int frames_ahead = frontend.frames_ahead;
+    bool vsync = frontend.vsync;
+    bool audio_sync = frontend.audio_sync;
+    bool audio_playing = false;
+
+    ZONE_THREAD_NAME("emulation");
 
-    SDL_Texture* sdlTexture = SDL_CreateTexture(renderer,
-            SDL_PIXELFORMAT_ARGB8888,
-            SDL_TEXTUREACCESS_STREAMING,
-            FRAME_HEIGHT * 8, FRAME_WIDTH * 8);
-    
-    NES *nes = new NES();
-    uint32_t pixels[2048];
-    
     std::cout << "Loading ROM..." << std::endl;
 
     load:
     // Attempt to load ROM
-    if (!nes->load_rom(argv[1])) {
-        return 2;
+    if (!nes->load_rom(frontend.rom_path)) {
+        frontend.result = 2;
+        frontend.running.store(false);
+        wake_main_thread(frontend);
+        return;
     }
     std::cout << "HERE" << std::endl;
-    while (true) {
-        nes->execute_next_instruction();
 
-        // Process SDL events
-        SDL_Event e;
-        while (SDL_PollEvent(&e)) {
+    // Recording restarts along with the ROM
+    Movie movie;
+    if (movie_path && !movie.start_recording(movie_path)) {
+        movie_path = nullptr;
+    }
+
+    RunAhead run_ahead(nes, frames_ahead);
+
+    // Hold tab to fast-forward, F2 picks the speed
+    Turbo turbo;
+
+    FramePacer pacer(NTSC_FRAME_RATE);
+    RateControl rate_control(AUDIO_SAMPLE_RATE, AUDIO_TARGET_LATENCY);
+
+    // Totals over the frames since the HUD was last updated
+    FrameTimeHistory frame_times;
+    FrameStats hud_totals;
+    memset(&hud_totals, 0, sizeof(hud_totals));
+    uint64_t input_ticks = 0;
+    uint64_t present_ticks = 0;
+    uint32_t hud_frames = 0;
+    uint64_t last_frame_start = 0;
+
+    bool running = true;
+    while (running) {
+        uint32_t presented_count = presenter->get_presented_count();
+
+        uint64_t frame_start = read_timestamp();
+        if (last_frame_start) {
+            frame_times.add(ticks_to_ms(frame_start - last_frame_start));
+        }
+        last_frame_start = frame_start;
+
+        turbo.start_frame();
+        nes->set_frame_skip(turbo.get_frame_skip());
+
+        // Fast-forwarded audio would only overflow the buffer
+        nes->set_audio_enabled(!turbo.is_enabled());
+
+        if (audio_device && !audio_sync) {
+            // Video sets the pace, so the audio rate follows whatever the device is actually draining
+            nes->set_audio_sample_rate(rate_control.update(audio->get_fill()));
+        }
+
+        if (movie_path) {
+            // The input that is in effect for the frame that's about to run
+            movie.record_frame(nes->get_controller_state());
+        }
+
+        // Run the core for exactly one frame
+        run_ahead.run_frame();
+
+        // The main thread presents it
+        wake_main_thread(frontend);
+
+        const FrameStats& frame_stats = nes->get_frame_stats();
+        hud_totals.instructions += frame_stats.instructions;
+        hud_totals.cpu_cycles += frame_stats.cpu_cycles;
+        hud_totals.frame_ticks += frame_stats.frame_ticks;
+        hud_totals.ppu_ticks += frame_stats.ppu_ticks;
+        hud_totals.apu_ticks += frame_stats.apu_ticks;
+        hud_totals.cpu_ticks += frame_stats.cpu_ticks;
+        present_ticks += presenter->get_present_ticks();
+        hud_frames++;
+
+        if (hud_frames == HUD_UPDATE_INTERVAL) {
+            if (hud->is_visible()) {
+                char text[256];
+                snprintf(text, sizeof(text),
+                         "FRAME P50 %.2f P99 %.2f MAX %.2f MS\n"
+                         "EMULATION %.2f MS CPU %.2f PPU %.2f APU %.2f\n"
+                         "%llu CYCLES %llu INSTRUCTIONS\n"
+                         "PRESENT %.2f MS INPUT %.3f MS",
+                         frame_times.get_percentile(0.5), frame_times.get_percentile(0.99), frame_times.get_max(),
+                         ticks_to_ms(hud_totals.frame_ticks) / hud_frames, ticks_to_ms(hud_totals.cpu_ticks) / hud_frames,
+                         ticks_to_ms(hud_totals.ppu_ticks) / hud_frames, ticks_to_ms(hud_totals.apu_ticks) / hud_frames,
+                         (unsigned long long) (hud_totals.cpu_cycles / hud_frames), (unsigned long long) (hud_totals.instructions / hud_frames),
+                         ticks_to_ms(present_ticks) / hud_frames, ticks_to_ms(input_ticks) / hud_frames);
+                hud->set_text(text);
+            }
+
+            memset(&hud_totals, 0, sizeof(hud_totals));
+            input_ticks = 0;
+            present_ticks = 0;
+            hud_frames = 0;
+        }
+
+        if (audio_device && !audio_playing && audio->get_fill() >= rate_control.get_target_fill()) {
+            SDL_PauseAudioDevice(audio_device, 0);
+            audio_playing = true;
+        }
+
+        if (audio_device && nes->get_frame_number() % 600 == 0) {
+            // Kiosks are monitored through these
+            std::cout << "Audio: fill " << audio->get_fill() * 1000 / AUDIO_SAMPLE_RATE << " ms, ratio " << rate_control.get_ratio()
+                      << ", underruns " << audio->get_underruns() << ", overflowed samples " << audio->get_overflowed_samples() << std::endl;
+        }
+
+        if (turbo.end_frame()) {
+            // Show the speed that's actually achieved
+            std::string title = "Nemulator";
+            if (turbo.is_enabled()) {
+                uint8_t multiplier = turbo.get_multiplier();
+                title += " - turbo " + (multiplier == TURBO_UNCAPPED ? std::string("max") : std::to_string(multiplier) + "x");
+                title += " (" + std::to_string(turbo.get_achieved_speed()).substr(0, 4) + "x)";
+            }
+            std::lock_guard<std::mutex> guard(frontend.lock);
+            frontend.title = title;
+        }
+
+        if (frames_ahead > 0 && nes->get_frame_number() % 300 == 0) {
+            // Report what run-ahead costs so the number of frames can be tuned per game
+            std::cout << "Run-ahead " << frames_ahead << ": frame " << run_ahead.get_average_frame_time() * 1000
+                      << " ms, run-ahead overhead " << run_ahead.get_average_overhead_time() * 1000 << " ms" << std::endl;
+            run_ahead.reset_statistics();
+        }
+
+        // Process the events the main thread polled, once per frame is plenty for input
+        bool turbo_enabled = turbo.is_enabled();
+        uint8_t turbo_multiplier = turbo.get_multiplier();
+
+        uint64_t input_start = read_timestamp();
+
+        std::vector<SDL_Event> events;
+        {
+            std::lock_guard<std::mutex> guard(frontend.lock);
+            events.swap(frontend.events);
+        }
+
+        for (const SDL_Event& e : events) {
             if (e.type == SDL_QUIT) {
-                delete nes;
-                exit(0);
+                running = false;
             }
 
             // Process keydown events
             if (e.type == SDL_KEYDOWN) {
                 if (e.key.keysym.sym == SDLK_ESCAPE) {
-                    delete nes;
-                    exit(0);
+                    running = false;
                 }
 
                 if (e.key.keysym.sym == SDLK_F1) {
@@ -95,6 +268,20 @@ int main(int argc, char **argv) {
                     goto load;     
                 }
 
+                if (e.key.keysym.sym == SDLK_TAB) {
+                    turbo.set_enabled(true);
+                }
+
+                if (e.key.keysym.sym == SDLK_F2) {
+                    turbo.next_multiplier();
+                }
+
+                if (e.key.keysym.sym == SDLK_F3) {
+                    // Timing every instruction isn't free, so it's only done while the HUD is up
+                    hud->set_visible(!hud->is_visible());
+                    nes->set_detailed_timing(hud->is_visible());
+                }
+
                 for (int i = 0; i < NR_OF_BUTTONS; ++i) {
                     if (e.key.keysym.sym == keymap[i]) {
                         std::cout << "DOWNPRESS DETECTED" << std::endl;
@@ -106,6 +293,10 @@ int main(int argc, char **argv) {
             }
             // Process keyup events
             if (e.type == SDL_KEYUP) {
+                if (e.key.keysym.sym == SDLK_TAB) {
+                    turbo.set_enabled(false);
+                }
+
                 for (int i = 0; i < NR_OF_BUTTONS; ++i) {
                     if (e.key.keysym.sym == keymap[i]) {
                         nes->change_button(i, false);
@@ -113,5 +304,243 @@ int main(int argc, char **argv) {
                 }
             }
         }
+
+        input_ticks += read_timestamp() - input_start;
+
+        if (!running) {
+            break;
+        }
+
+        if (turbo.is_enabled() != turbo_enabled || turbo.get_multiplier() != turbo_multiplier) {
+            // Pace from now at the new speed
+            pacer.set_frame_rate(turbo.is_enabled() ? turbo.get_frame_rate() : NTSC_FRAME_RATE);
+            pacer.reset();
+        }
+
+        // Until the end of the loop, which is all pacing
+        ZONE("pace");
+
+        if (turbo.is_enabled()) {
+            if (turbo.get_multiplier() != TURBO_UNCAPPED) {
+                pacer.wait();
+            }
+        } else if (audio_sync && audio_playing) {
+            // The device drains the buffer at exactly the sample rate, so keeping it at the target paces us
+            while (audio->get_fill() > rate_control.get_target_fill()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        } else if (vsync && nes->is_frame_rendered()) {
+            // The presenter blocks on the display refresh, so waiting for it to show our frame paces us
+            presenter->wait_for_present(presented_count);
+        } else {
+            pacer.wait();
+        }
+    }
+
+    frontend.running.store(false);
+    wake_main_thread(frontend);
+}
+
+int main(int argc, char **argv) {
+    uint8_t a = 160;
+    std::cout << ((uint16_t) a << 4) << std::endl;
+    /*
+    char nes[4] = "NES";
+    char bits[4];
+    bits[0] = 0x4E;
+    bits[1] = 0x45;
+    bits[2] = 0x53;
+    bits[3] = 0x1A;
+    bool test = 1;
+    bool test2 = true;
+    uint8_t z = 0xFA;
+    std::cout << "Hello NES" << std::endl << ("a" > "A") << std::endl;
+    */
+    
+    // Usage: NES [--vsync] [--audio-sync] [--record movie] [--run-ahead n] [--upscale filter] [--upscale-threads n] [--zones path] [--db path] <rom>
+    const char* rom_path = nullptr;
+    const char* movie_path = nullptr;
+    const char* upscale_filter = nullptr;
+    const char* zones_path = nullptr;
+    const char* database_path = nullptr;
+    bool vsync = false;
+    bool audio_sync = false;
+    int frames_ahead = 0;
+    int upscale_threads = std::thread::hardware_concurrency() < 4 ? std::thread::hardware_concurrency() : 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vsync") == 0) {
+            // Pace emulation by the display refresh instead of the timer
+            vsync = true;
+        } else if (strcmp(argv[i], "--audio-sync") == 0) {
+            // Pace emulation by the audio device draining the buffer instead of the timer
+            audio_sync = true;
+        } else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc) {
+            // Show the frame this many frames ahead, hiding the game's own input lag
+            frames_ahead = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--upscale") == 0 && i + 1 < argc) {
+            // Scale frames up on the CPU (nearest2x-4x, scale2x-4x, xbr2x, xbr4x) before they're shown
+            upscale_filter = argv[++i];
+        } else if (strcmp(argv[i], "--upscale-threads") == 0 && i + 1 < argc) {
+            upscale_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            // Record the input of every frame, to be played back with NES_headless --play
+            movie_path = argv[++i];
+        } else if (strcmp(argv[i], "--zones") == 0 && i + 1 < argc) {
+            // Chrome trace of the instrumentation zones on exit, in builds with NES_INSTRUMENTATION
+            zones_path = argv[++i];
+        } else if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            // Correct the headers of known ROMs, see NES_romdb
+            database_path = argv[++i];
+        } else {
+            rom_path = argv[i];
+        }
+    }
+
+    if (!rom_path) {
+        std::cout << "Usage: " << argv[0] << " [--vsync] [--audio-sync] [--record movie] [--run-ahead n] [--upscale filter] [--upscale-threads n] [--zones path] [--db path] <rom>" << std::endl;
+        return 2;
+    }
+
+    // Created before the window, which is sized to its output so upscaled frames aren't scaled back down
+    Upscaler* upscaler = nullptr;
+    if (upscale_filter) {
+        upscaler = new Upscaler(upscale_threads);
+
+        if (!upscaler->set_filter(upscale_filter)) {
+            delete upscaler;
+            return 2;
+        }
     }
+
+    SDL_Window *window;
+
+    if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
+        std::cout << "Failed to initialize SDL" << std::endl;
+        return 1;
+    }
+
+    window = SDL_CreateWindow("Nemulator", 
+                               SDL_WINDOWPOS_UNDEFINED,
+                               SDL_WINDOWPOS_UNDEFINED,
+                               upscaler ? upscaler->get_output_width() : SCREEN_WIDTH,
+                               upscaler ? upscaler->get_output_height() : SCREEN_HEIGHT,
+                               SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+
+    if (!window) {
+        std::cout << "Failed to create window" << std::endl;
+    }
+
+    NES *nes = new NES();
+
+    RomDatabase database;
+    if (database_path && database.load(database_path)) {
+        nes->set_rom_database(&database);
+    }
+
+    // Mono 16-bit audio, fed by the APU through a lock-free ring buffer
+    AudioBuffer* audio = new AudioBuffer(AUDIO_BUFFER_CAPACITY);
+    nes->set_audio_output(audio);
+
+    SDL_AudioSpec audio_spec;
+    memset(&audio_spec, 0, sizeof(audio_spec));
+    audio_spec.freq = AUDIO_SAMPLE_RATE;
+    audio_spec.format = AUDIO_S16SYS;
+    audio_spec.channels = 1;
+    audio_spec.samples = AUDIO_DEVICE_SAMPLES;
+    audio_spec.callback = audio_callback;
+    audio_spec.userdata = audio;
+
+    // Playback starts once the buffer has filled up to the target latency
+    SDL_AudioDeviceID audio_device = SDL_OpenAudioDevice(nullptr, 0, &audio_spec, nullptr, 0);
+
+    if (!audio_device) {
+        std::cout << "Failed to open audio device, continuing without sound" << std::endl;
+    }
+
+    // F3 shows where the frame time goes
+    Hud* hud = new Hud();
+
+    // Frames are presented here, on the thread that owns the window, and emulated on a thread of their own
+    Presenter* presenter = new Presenter(window, nes->get_frame_buffer(), vsync, upscaler, hud);
+
+    Frontend frontend;
+    frontend.nes = nes;
+    frontend.presenter = presenter;
+    frontend.hud = hud;
+    frontend.audio = audio;
+    frontend.audio_device = audio_device;
+    frontend.rom_path = rom_path;
+    frontend.movie_path = movie_path;
+    frontend.frames_ahead = frames_ahead;
+    frontend.vsync = vsync;
+    frontend.audio_sync = audio_sync;
+    frontend.running.store(true);
+    frontend.result = 0;
+    frontend.frame_event = SDL_RegisterEvents(1);
+    frontend.frame_event_pending.store(false);
+
+    ZONE_THREAD_NAME("main");
+
+    std::thread emulation(emulate, std::ref(frontend));
+
+    while (frontend.running.load()) {
+        // Sleep until there's input or a new frame
+        SDL_Event e;
+        if (!SDL_WaitEventTimeout(&e, MAIN_WAIT_TIMEOUT)) {
+            continue;
+        }
+
+        bool new_frame = false;
+        std::vector<SDL_Event> input;
+
+        do {
+            if (e.type == frontend.frame_event) {
+                new_frame = true;
+            } else if (e.type == SDL_QUIT || e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+                input.push_back(e);
+            }
+        } while (SDL_PollEvent(&e));
+
+        std::string title;
+        {
+            std::lock_guard<std::mutex> guard(frontend.lock);
+            frontend.events.insert(frontend.events.end(), input.begin(), input.end());
+            title.swap(frontend.title);
+        }
+
+        if (!title.empty()) {
+            SDL_SetWindowTitle(window, title.c_str());
+        }
+
+        if (new_frame) {
+            frontend.frame_event_pending.store(false);
+            presenter->present();
+        }
+    }
+
+    // The emulation thread could be waiting on vsync for a frame that won't be shown anymore
+    presenter->wake();
+    emulation.join();
+
+    // Stop presenting and playing before the buffers go away with the NES
+    if (audio_device) {
+        SDL_CloseAudioDevice(audio_device);
+    }
+
+    delete presenter;
+
+    if (zones_path) {
+        write_zone_trace(zones_path);
+    }
+
+    delete hud;
+    delete upscaler;
+    delete nes;
+    delete audio;
+
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+
+    return frontend.result;
 }
\ No newline at end of file
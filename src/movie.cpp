@@ -0,0 +1,121 @@
+#include "movie.h"
+
+Movie::Movie() {
+    recording = false;
+    frames = nullptr;
+    capacity = 0;
+    used = 0;
+    nr_of_frames = 0;
+    position = 0;
+}
+
+Movie::~Movie() {
+    stop_recording();
+    delete[] frames;
+}
+
+void Movie::write_header() {
+    uint8_t header[MOVIE_HEADER_SIZE] = {};
+
+    memcpy(header, MOVIE_MAGIC, 4);
+    header[4] = MOVIE_VERSION;
+    header[5] = 1; // Number of controllers
+
+    // Little endian frame count
+    for (int i = 0; i < 4; i++) {
+        header[8 + i] = (nr_of_frames >> (8 * i)) & 0xFF;
+    }
+
+    file.seekp(0);
+    file.write((char*) header, MOVIE_HEADER_SIZE);
+}
+
+bool Movie::start_recording(const char* path) {
+    file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+
+    if (!file) {
+        std::cout << "Failed to open movie " << path << std::endl;
+        return false;
+    }
+
+    delete[] frames;
+    frames = new uint8_t[MOVIE_BUFFER_SIZE];
+    capacity = MOVIE_BUFFER_SIZE;
+    used = 0;
+    nr_of_frames = 0;
+
+    // The frame count is filled in when recording stops
+    write_header();
+    recording = true;
+
+    return true;
+}
+
+void Movie::record_frame(uint8_t controller_state) {
+    if (used == capacity) {
+        flush();
+    }
+
+    frames[used++] = controller_state;
+    nr_of_frames++;
+}
+
+void Movie::flush() {
+    file.write((char*) frames, used);
+    used = 0;
+}
+
+void Movie::stop_recording() {
+    if (!recording) {
+        return;
+    }
+
+    flush();
+    write_header();
+    file.close();
+
+    recording = false;
+}
+
+bool Movie::load(const char* path) {
+    std::ifstream input(path, std::ios::binary);
+
+    if (!input) {
+        std::cout << "Failed to open movie " << path << std::endl;
+        return false;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    input.read((char*) header, MOVIE_HEADER_SIZE);
+
+    if (!input || memcmp(header, MOVIE_MAGIC, 4) != 0 || header[4] != MOVIE_VERSION || header[5] != 1) {
+        std::cout << "Invalid movie header" << std::endl;
+        return false;
+    }
+
+    uint32_t frame_count = 0;
+    for (int i = 0; i < 4; i++) {
+        frame_count |= header[8 + i] << (8 * i);
+    }
+
+    // Don't trust the header further than the file goes
+    input.seekg(0, std::ios::end);
+    uint64_t available = (uint64_t) input.tellg() - MOVIE_HEADER_SIZE;
+    input.seekg(MOVIE_HEADER_SIZE);
+
+    if (frame_count > available) {
+        std::cout << "Movie is truncated, playing " << available << " of " << frame_count << " frames" << std::endl;
+        frame_count = available;
+    }
+
+    delete[] frames;
+    frames = new uint8_t[frame_count];
+    capacity = frame_count;
+    input.read((char*) frames, frame_count);
+
+    nr_of_frames = frame_count;
+    used = frame_count;
+    position = 0;
+
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+
+#define MOVIE_MAGIC "NMV\x1A"
+#define MOVIE_VERSION 1
+#define MOVIE_HEADER_SIZE 12
+#define MOVIE_BUFFER_SIZE 0x10000 // Frames kept in memory before they are written out
+
+// Controller input per frame, recorded while playing and replayed bit-exactly later.
+// The file is a 12-byte header followed by one byte of button state per frame.
+class Movie {
+private:
+    std::fstream file;
+    bool recording;
+
+    // Recording writes into this buffer, playback holds the entire movie in it
+    uint8_t* frames;
+    uint32_t capacity;
+    uint32_t used;
+
+    uint32_t nr_of_frames;
+    uint32_t position;
+
+    void flush();
+    void write_header();
+public:
+    Movie();
+    ~Movie();
+
+    bool start_recording(const char* path);
+    void record_frame(uint8_t controller_state); // Never allocates, the buffer is written out when full
+    void stop_recording();
+
+    bool load(const char* path);
+    bool is_finished() { return position >= nr_of_frames; }
+    uint8_t next_frame() { return frames[position++]; }
+    void rewind() { position = 0; }
+
+    uint32_t get_nr_of_frames() { return nr_of_frames; }
+    uint32_t get_position() { return position; }
+};
+
+#endif
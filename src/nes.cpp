@@ -1,8 +1,16 @@
 #include "nes.h"
+#include "instrumentation.h"
+#include "crc32.h"
 
 NES::NES() {
     std::cout << "INIT..." << std::endl;
     bus = new Bus();
+    cartridge = nullptr;
+    cdl = nullptr;
+    profiler = nullptr;
+    database = nullptr;
+    rom_crc = 0;
+    memset(&frame_stats, 0, sizeof(frame_stats));
 
     controller = new Controller();
     bus->attach_controller(controller);
@@ -12,70 +20,152 @@ NES::~NES() {
     delete bus;
     delete controller;
     delete cartridge;
-}
-
-void NES::parse_header(std::ifstream& input) {
-    cartridge = new Cartridge(input);
+    delete cdl;
+    delete profiler;
 }
 
 bool NES::load_rom(const char* rom_path) {
     std::ifstream input(rom_path, std::ios::binary);
-    parse_header(input);
 
-    if (cartridge->has_trainer()) {
-        // Skip next 512 bytes if trainer is present
-        input.ignore(512);
+    if (!input) {
+        std::cout << "Failed to open ROM" << std::endl;
+        return false;
     }
 
-    // Array to store all PRG-ROM banks
-    uint8_t **prg_rom_banks = new uint8_t*[cartridge->get_nr_prg_rom_banks()];
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    return load_rom(data.data(), data.size());
+}
 
-    // Storage for CHR-ROM banks, could be 0 so we check before initializing
-    char **chr_rom_banks;
+bool NES::load_rom(const uint8_t* data, size_t size) {
+    Cartridge* new_cartridge = new Cartridge(data, size);
 
-    if (cartridge->get_nr_chr_rom_banks() > 0) {
-        chr_rom_banks = new char*[cartridge->get_nr_chr_rom_banks()];
+    // Only trust the bank counts once it's certain the data actually holds that many banks
+    if (!new_cartridge->is_valid_header()) {
+        delete new_cartridge;
+        return false;
+    }
+
+    if (new_cartridge->get_nr_prg_rom_banks() == 0) {
+        std::cout << "Invalid ROM: no PRG-ROM banks" << std::endl;
+        delete new_cartridge;
+        return false;
     }
 
-    // Read all PRG-ROM banks
-    for (int i = 0; i < cartridge->get_nr_prg_rom_banks(); i++) {
-        prg_rom_banks[i] = (uint8_t*) new char[0x4000];
-        input.read((char*) prg_rom_banks[i], 0x4000);
+    if (size < new_cartridge->get_rom_size()) {
+        std::cout << "Invalid ROM: the header promises " << new_cartridge->get_rom_size() << " bytes, but there are only " << size << std::endl;
+        delete new_cartridge;
+        return false;
     }
 
-    // Read all CHR-ROM banks
-    for (int i = 0; i < cartridge->get_nr_chr_rom_banks(); i++) {
-        chr_rom_banks[i] = new char[0x2000];
-        input.read(chr_rom_banks[i], 0x2000);
+    // Skip the trainer if it's present
+    const uint8_t* prg_rom = data + INES_HEADER_SIZE + (new_cartridge->has_trainer() ? TRAINER_SIZE : 0);
+    const uint8_t* chr_rom = prg_rom + new_cartridge->get_nr_prg_rom_banks() * PRG_ROM_BANK_SIZE;
+
+    // Databases identify ROMs by their contents, the header is exactly what may be wrong
+    rom_crc = crc32(prg_rom, new_cartridge->get_rom_size() - (prg_rom - data));
+
+    RomDatabaseEntry entry;
+    if (database && database->find(rom_crc, entry)) {
+        std::cout << "ROM " << std::hex << rom_crc << std::dec << " found in the database, replacing its header" << std::endl;
+        new_cartridge->apply_database_entry(entry);
+        new_cartridge->print();
     }
 
-    if (cartridge->get_nr_prg_rom_banks() == 1) {
-        // With only 1 PRG-ROM bank, write to both banks in memory
-        bus->write_array_to_memory((uint8_t*) prg_rom_banks[0], LOWER_PRG_ROM_START, 0x4000);
-        bus->write_array_to_memory((uint8_t*) prg_rom_banks[0], UPPER_PRG_ROM_START, 0x4000);
-    } else if (cartridge->get_nr_prg_rom_banks() == 2) {
-        // With 2 PRG-ROM banks, write one to each bank in memory
-        bus->write_array_to_memory((uint8_t*) prg_rom_banks[0], LOWER_PRG_ROM_START, 0x4000);
-        bus->write_array_to_memory((uint8_t*) prg_rom_banks[1], UPPER_PRG_ROM_START, 0x4000);
+    // The cartridge decides how the name tables are mirrored, so attach it before touching PPU memory
+    bus->attach_cartridge(new_cartridge);
+    delete cartridge;
+    cartridge = new_cartridge;
+
+    if (cartridge->get_nr_chr_rom_banks() > 0) {
+        // Map the first CHR-ROM bank into the pattern tables
+        bus->write_array_to_ppu(chr_rom, PATTERN_TABLE_BOTTOM, CHR_ROM_BANK_SIZE);
+    }
+
+    // With only 1 PRG-ROM bank it shows up in both windows, UNROM starts with the first and last bank
+    bus->write_array_to_memory(prg_rom + cartridge->get_prg_bank(0) * PRG_ROM_BANK_SIZE, LOWER_PRG_ROM_START, PRG_ROM_BANK_SIZE);
+    bus->write_array_to_memory(prg_rom + cartridge->get_prg_bank(1) * PRG_ROM_BANK_SIZE, UPPER_PRG_ROM_START, PRG_ROM_BANK_SIZE);
+
+    if (cdl) {
+        // A log of the previous ROM means nothing for this one
+        set_code_data_logging(true);
+    }
+
+    return true;
+}
+
+bool NES::set_code_data_logging(bool enabled) {
+    bus->attach_code_data_logger(nullptr);
+    delete cdl;
+    cdl = nullptr;
+
+    if (!enabled) {
+        return true;
     }
 
-    if (cartridge->get_mapper_number() == 2) {
-        // UNROM Switch is used; load first and last PRG-ROM bank into memory
-        uint8_t last_bank_index = cartridge->get_nr_prg_rom_banks() - 1;
-        bus->write_array_to_memory((uint8_t*) prg_rom_banks[0], LOWER_PRG_ROM_START, 0x4000);
-        bus->write_array_to_memory((uint8_t*) prg_rom_banks[last_bank_index], UPPER_PRG_ROM_START, 0x4000);
+    if (!cartridge) {
+        std::cout << "Load a ROM before logging code and data" << std::endl;
+        return false;
     }
-    
-    std::cout << cartridge->is_valid_header() << ", " << (int) cartridge->get_nr_prg_rom_banks() << std::endl;
-    bus->attach_cartridge(cartridge);
+
+    cdl = new CodeDataLogger(cartridge->get_nr_prg_rom_banks() * PRG_ROM_BANK_SIZE);
+    cdl->map_window(0, cartridge->get_prg_bank(0));
+    cdl->map_window(1, cartridge->get_prg_bank(1));
+    bus->attach_code_data_logger(cdl);
 
     return true;
 }
 
+void NES::set_profiling(bool enabled, uint32_t interval) {
+    bus->get_cpu()->attach_profiler(nullptr);
+    delete profiler;
+    profiler = nullptr;
+
+    if (enabled) {
+        profiler = new Profiler(interval);
+        bus->get_cpu()->attach_profiler(profiler);
+    }
+}
+
 void NES::execute_next_instruction() {
     bus->execute_next_instruction();
 }
 
+void NES::reset() {
+    // Reset silences all APU channels
+    bus->write_to_memory(APU_STATUS_REGISTER, 0);
+    bus->get_cpu()->reset();
+}
+
+uint32_t NES::run_frame() {
+    ZONE("frame");
+
+    PPU* ppu = bus->get_ppu();
+    uint32_t cycles = 0;
+
+    uint64_t start = read_timestamp();
+    bus->reset_stats();
+    ppu->reset_render_ticks();
+
+    while (!ppu->is_frame_complete()) {
+        cycles += bus->execute_next_instruction();
+    }
+
+    ppu->clear_frame_complete();
+
+    FrameStats& stats = bus->get_stats();
+    {
+        ScopedTimer timer(&stats.apu_ticks);
+        ZONE("apu end frame");
+        bus->get_apu()->end_frame();
+    }
+
+    stats.ppu_ticks = ppu->get_render_ticks();
+    stats.frame_ticks = read_timestamp() - start;
+    frame_stats = stats;
+
+    return cycles;
+}
+
 void NES::change_button(uint8_t button_index, bool pressed) {
     std::cout << "HERE1" << std::endl;
     bus->change_button(button_index, pressed);
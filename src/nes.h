@@ -5,24 +5,78 @@
 #include <string.h>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 #include "bus.h"
 #include "cpu.h"
 #include "cartridge.h"
+#include "rom_database.h"
 
 class NES {
 private:
     Bus* bus;
     Controller* controller;
     Cartridge* cartridge;
+    CodeDataLogger* cdl;
+    Profiler* profiler;
+    const RomDatabase* database;
+    uint32_t rom_crc; // Of PRG-ROM and CHR-ROM together
+
+    FrameStats frame_stats; // Of the last frame that was run
 public:
     NES();
     ~NES();
 
     bool load_rom(const char* rom_path); // Loads the ROM into memory
-    void parse_header(std::ifstream& input); // Parse the iNES-header
+    bool load_rom(const uint8_t* data, size_t size); // Same for a ROM image that is already in memory, which may be untrusted
     void execute_next_instruction();
+    void reset(); // Press the reset button; memory and the cartridge are kept
+    uint32_t run_frame(); // Run until the PPU completes a frame, returns the number of CPU cycles taken
     void change_button(uint8_t button_index, bool pressed);
+
+    // ROMs found in the database get its mapper, mirroring and RAM sizes instead of what their header says
+    void set_rom_database(const RomDatabase* rom_database) { database = rom_database; }
+    uint32_t get_rom_crc() { return rom_crc; }
+
+    // State of all buttons of the controller, used to record and play back movies
+    uint8_t get_controller_state() { return controller->get_state(); }
+    void set_controller_state(uint8_t state) { controller->set_state(state); }
+
+    TripleBuffer* get_frame_buffer() { return bus->get_ppu()->get_frame_buffer(); }
+
+    // Only compose 1 out of every skip + 1 frames, FRAME_SKIP_NEVER_RENDER turns drawing off entirely
+    void set_frame_skip(uint8_t skip) { bus->get_ppu()->set_frame_skip(skip); }
+    bool is_frame_rendered() { return bus->get_ppu()->is_frame_rendered(); }
+    uint8_t get_frame_skip() { return bus->get_ppu()->get_frame_skip(); }
+    uint64_t get_frame_number() { return bus->get_ppu()->get_frame_number(); }
+
+    // Samples are written to output at AUDIO_SAMPLE_RATE while audio is enabled
+    void set_audio_output(AudioBuffer* output) { bus->get_apu()->set_output(output); }
+    void set_audio_enabled(bool enabled) { bus->get_apu()->set_output_enabled(enabled); }
+    bool is_audio_enabled() { return bus->get_apu()->is_output_enabled(); }
+    void set_audio_sample_rate(double rate) { bus->get_apu()->set_sample_rate(rate); }
+
+    // Where the time of the last frame went; CPU and APU stepping are only timed with detailed timing
+    const FrameStats& get_frame_stats() { return frame_stats; }
+    void set_detailed_timing(bool enabled) { bus->set_detailed_timing(enabled); }
+
+    // Code/Data Logging of PRG-ROM, starts out empty for every ROM that is loaded
+    bool set_code_data_logging(bool enabled);
+    CodeDataLogger* get_code_data_logger() { return cdl; }
+
+    // Samples the guest call stack every interval CPU cycles, starting from an empty profile
+    void set_profiling(bool enabled, uint32_t interval = PROFILER_DEFAULT_INTERVAL);
+    Profiler* get_profiler() { return profiler; }
+
+    // Whole-machine snapshots, e.g. for run-ahead
+    void save_state(MachineState& state) { bus->save_state(state); }
+    void load_state(const MachineState& state) { bus->load_state(state); }
+
+    // Just the CPU registers, cheap enough to check after every instruction
+    void save_cpu_state(CPUState& state) { bus->get_cpu()->save_state(state); }
+    void load_cpu_state(const CPUState& state) { bus->get_cpu()->load_state(state); }
+    uint8_t read_from_cpu(uint16_t address) { return bus->read_from_cpu(address); }
+    const uint8_t* get_ram() { return bus->get_cpu_ram(); } // CPU_RAM_SIZE bytes, read without side effects
 };
 
 #endif
\ No newline at end of file
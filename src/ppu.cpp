@@ -1,81 +1,691 @@
 #include "ppu.h"
+#include "instrumentation.h"
 
 PPU::PPU() {
-    display = new uint32_t*[FRAME_HEIGHT * 8];
-    for (int i = 0; i < FRAME_HEIGHT * 8; i++) {
-        display[i] = new uint32_t[FRAME_WIDTH * 8];
-    }
+    frames = new TripleBuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+    display = frames->get_back();
+
+    background = new uint32_t[SCREEN_WIDTH * SCREEN_HEIGHT];
+    background_opaque = new uint8_t[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+    reset();
 }
 
 PPU::~PPU() {
-    for (int i = 0; i < FRAME_HEIGHT * 8; i++) {
-        delete[] display[i];
+    delete frames;
+    delete[] background;
+    delete[] background_opaque;
+}
+
+void PPU::reset() {
+    control_1 = 0;
+    control_2 = 0;
+    status = 0;
+    spr_ram_address = 0;
+    scroll_x = 0;
+    scroll_y = 0;
+    vram_address = 0;
+    read_buffer = 0;
+    address_latch = false;
+
+    // Start on the pre-render line so the first frame latches its scroll on every visible line
+    scanline = PRE_RENDER_SCANLINE;
+    dot = 0;
+    frame_complete = false;
+    frame_number = 0;
+
+    frame_skip = 0;
+    skipped_frames = 0;
+    frame_rendered = false;
+    render_ticks = 0;
+
+    memset(line_scroll_x, 0, SCREEN_HEIGHT);
+    memset(line_scroll_y, 0, SCREEN_HEIGHT);
+    memset(line_name_table, 0, SCREEN_HEIGHT);
+
+    full_redraw = true;
+    memset(tile_dirty, 0, sizeof(tile_dirty));
+    memset(pattern_dirty, 0, sizeof(pattern_dirty));
+    memset(palette_dirty, 0, sizeof(palette_dirty));
+    any_dirty = false;
+
+    memset(tile_pattern, 0, NR_OF_TILES);
+    memset(tile_palette, 0, NR_OF_TILES);
+    cached_name_table = NAME_TABLE_BOTTOM;
+    palette_cache_dirty = true;
+
+    memset(line_sprite_count, 0, SCREEN_HEIGHT);
+    overflow_scanline = NO_SCANLINE;
+    sprite_zero_hit_scanline = NO_SCANLINE;
+    sprite_zero_hit_dot = 0;
+}
+
+void PPU::save_state(PPUState& state) {
+    state.control_1 = control_1;
+    state.control_2 = control_2;
+    state.status = status;
+    state.spr_ram_address = spr_ram_address;
+    state.scroll_x = scroll_x;
+    state.scroll_y = scroll_y;
+    state.vram_address = vram_address;
+    state.read_buffer = read_buffer;
+    state.address_latch = address_latch;
+
+    state.scanline = scanline;
+    state.dot = dot;
+    state.frame_complete = frame_complete;
+    state.frame_number = frame_number;
+
+    memcpy(state.line_scroll_x, line_scroll_x, SCREEN_HEIGHT);
+    memcpy(state.line_scroll_y, line_scroll_y, SCREEN_HEIGHT);
+    memcpy(state.line_name_table, line_name_table, SCREEN_HEIGHT);
+
+    memcpy(state.line_sprites, line_sprites, sizeof(line_sprites));
+    memcpy(state.line_sprite_count, line_sprite_count, SCREEN_HEIGHT);
+    state.overflow_scanline = overflow_scanline;
+    state.sprite_zero_hit_scanline = sprite_zero_hit_scanline;
+    state.sprite_zero_hit_dot = sprite_zero_hit_dot;
+}
+
+void PPU::load_state(const PPUState& state) {
+    control_1 = state.control_1;
+    control_2 = state.control_2;
+    status = state.status;
+    spr_ram_address = state.spr_ram_address;
+    scroll_x = state.scroll_x;
+    scroll_y = state.scroll_y;
+    vram_address = state.vram_address;
+    read_buffer = state.read_buffer;
+    address_latch = state.address_latch;
+
+    scanline = state.scanline;
+    dot = state.dot;
+    frame_complete = state.frame_complete;
+    frame_number = state.frame_number;
+
+    memcpy(line_scroll_x, state.line_scroll_x, SCREEN_HEIGHT);
+    memcpy(line_scroll_y, state.line_scroll_y, SCREEN_HEIGHT);
+    memcpy(line_name_table, state.line_name_table, SCREEN_HEIGHT);
+
+    memcpy(line_sprites, state.line_sprites, sizeof(line_sprites));
+    memcpy(line_sprite_count, state.line_sprite_count, SCREEN_HEIGHT);
+    overflow_scanline = state.overflow_scanline;
+    sprite_zero_hit_scanline = state.sprite_zero_hit_scanline;
+    sprite_zero_hit_dot = state.sprite_zero_hit_dot;
+
+    // PPU memory was restored underneath the caches
+    full_redraw = true;
+    palette_cache_dirty = true;
+}
+
+void PPU::update_palette_cache() {
+    uint8_t emphasis = control_2 >> 5;
+
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        uint8_t colour_index = bus->read_from_ppu(IMAGE_PALETTE_BOTTOM + i) & 0x3F;
+
+        if (control_2 & 0x01) {
+            // Greyscale only keeps the brightness column of the palette
+            colour_index &= 0x30;
+        }
+
+        uint32_t colour = colour_palette[colour_index];
+
+        if (emphasis) {
+            // Emphasis darkens the channels that are not emphasized; bit 0 is red, bit 1 green and bit 2 blue
+            uint8_t channels[3] = { (uint8_t) (colour >> 16), (uint8_t) (colour >> 8), (uint8_t) colour };
+
+            for (int channel = 0; channel < 3; channel++) {
+                if (!(emphasis & (0b1 << channel))) {
+                    channels[channel] = (channels[channel] * 209) >> 8;
+                }
+            }
+
+            colour = (channels[0] << 16) | (channels[1] << 8) | channels[2];
+        }
+
+        palette_cache[i] = 0xFF000000 | colour;
     }
 
-    delete[] display;
+    palette_cache_dirty = false;
 }
 
-void PPU::fill_tile(uint8_t tile_x, uint8_t tile_y, uint8_t palette_index) {
+void PPU::fill_tile(uint8_t tile_x, uint8_t tile_y) {
     int name_table_index = tile_y * FRAME_WIDTH + tile_x;
 
-    int pattern_table_index = bus->read_from_ppu(NAME_TABLE_BOTTOM + name_table_index);
+    int pattern_table_index = bus->read_from_ppu(cached_name_table + name_table_index);
+
+    // Every attribute byte covers 4x4 tiles, with 2 bits for each 2x2 quadrant
+    uint8_t attribute_byte = bus->read_from_ppu(cached_name_table + ATTRIBUTE_TABLE_OFFSET + (tile_y / 4) * 8 + tile_x / 4);
+    uint8_t palette_index = (attribute_byte >> (((tile_y & 0b10) << 1) | (tile_x & 0b10))) & 0b11;
+
+    // Remember what the tile was rendered with so later writes can be matched against it
+    tile_pattern[name_table_index] = pattern_table_index;
+    tile_palette[name_table_index] = palette_index;
+
+    uint16_t pattern_address = get_background_pattern_table() + pattern_table_index * 16;
 
     // Fill all 8x8 pixels of the tile
     for (int y = 0; y < 8; y++) {
 
-        uint16_t lower = bus->read_from_ppu(PATTERN_TABLE_BOTTOM + pattern_table_index*16 + y);
-        uint16_t upper = bus->read_from_ppu(PATTERN_TABLE_BOTTOM + pattern_table_index*16 + y + 8);
+        uint8_t lower = bus->read_from_ppu(pattern_address + y);
+        uint8_t upper = bus->read_from_ppu(pattern_address + y + 8);
+
+        uint32_t* row = background + (tile_y * 8 + y) * SCREEN_WIDTH + tile_x * 8;
+        uint8_t* opaque_row = background_opaque + (tile_y * 8 + y) * SCREEN_WIDTH + tile_x * 8;
 
         for (int x = 0; x < 8; x++) {
             uint8_t shift = 7 - x;
             // Combine 1 bit from upper with 1 from lower to get te index to use in the palette
-            uint8_t frame_palette_index = ((upper & (0b1 << shift)) >> (shift - 1)) | ((lower & (0b1 << shift)) >> shift);
+            uint8_t frame_palette_index = (((upper >> shift) & 0b1) << 1) | ((lower >> shift) & 0b1);
 
             // Assign the correct color to the current pixel
-            display[tile_y * 8 + y][tile_x * 8 + x] = colour_palette[bus->read_from_ppu(SPRITE_PALETTE_BOTTOM + palette_index * 4 + frame_palette_index)];
+            row[x] = background_colour(palette_index, frame_palette_index);
+            opaque_row[x] = frame_palette_index != 0;
+        }
+    }
+}
+
+void PPU::fill_scanline(uint8_t y) {
+    // Position of the line within the 2x2 arrangement of name tables
+    uint16_t world_y = (y + line_scroll_y[y] + (line_name_table[y] >> 1) * SCREEN_HEIGHT) % (SCREEN_HEIGHT * 2);
+    uint16_t world_x = line_scroll_x[y] + (line_name_table[y] & 0b1) * SCREEN_WIDTH;
+
+    uint8_t tile_y = (world_y % SCREEN_HEIGHT) / 8;
+    uint8_t fine_y = world_y % 8;
+
+    uint16_t pattern_table = get_background_pattern_table();
+    uint32_t* row = background + y * SCREEN_WIDTH;
+    uint8_t* opaque_row = background_opaque + y * SCREEN_WIDTH;
+
+    int x = 0;
+    while (x < SCREEN_WIDTH) {
+        uint16_t tile_world_x = (world_x + x) % (SCREEN_WIDTH * 2);
+        uint16_t name_table_address = get_name_table_address((world_y / SCREEN_HEIGHT) * 2 + tile_world_x / SCREEN_WIDTH);
+        uint8_t tile_x = (tile_world_x % SCREEN_WIDTH) / 8;
+
+        uint8_t pattern_table_index = bus->read_from_ppu(name_table_address + tile_y * FRAME_WIDTH + tile_x);
+        uint8_t attribute_byte = bus->read_from_ppu(name_table_address + ATTRIBUTE_TABLE_OFFSET + (tile_y / 4) * 8 + tile_x / 4);
+        uint8_t palette_index = (attribute_byte >> (((tile_y & 0b10) << 1) | (tile_x & 0b10))) & 0b11;
+
+        uint8_t lower = bus->read_from_ppu(pattern_table + pattern_table_index * 16 + fine_y);
+        uint8_t upper = bus->read_from_ppu(pattern_table + pattern_table_index * 16 + fine_y + 8);
+
+        // The first tile of the line can be partially scrolled out of view
+        for (uint8_t fine_x = tile_world_x % 8; fine_x < 8 && x < SCREEN_WIDTH; fine_x++, x++) {
+            uint8_t shift = 7 - fine_x;
+            uint8_t frame_palette_index = (((upper >> shift) & 0b1) << 1) | ((lower >> shift) & 0b1);
+
+            row[x] = background_colour(palette_index, frame_palette_index);
+            opaque_row[x] = frame_palette_index != 0;
+        }
+    }
+}
+
+void PPU::update_background() {
+    // The cache only lines up with the screen when no line is scrolled and they all show the same name table
+    bool aligned = line_scroll_x[0] == 0 && line_scroll_y[0] == 0;
+    for (int y = 1; y < SCREEN_HEIGHT && aligned; y++) {
+        aligned = line_scroll_x[y] == 0 && line_scroll_y[y] == 0 && line_name_table[y] == line_name_table[0];
+    }
+
+    if (!aligned) {
+        // Scrolled or split screen; render every line and rebuild the cache once the screen is aligned again
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            fill_scanline(y);
+        }
+
+        full_redraw = true;
+    } else {
+        uint16_t name_table = bus->mirror_ppu_address(get_name_table_address(line_name_table[0]));
+        if (name_table != cached_name_table) {
+            cached_name_table = name_table;
+            full_redraw = true;
         }
+
+        if (full_redraw) {
+            for (uint8_t tile_y = 0; tile_y < FRAME_HEIGHT; tile_y++) {
+                for (uint8_t tile_x = 0; tile_x < FRAME_WIDTH; tile_x++) {
+                    fill_tile(tile_x, tile_y);
+                }
+            }
+        } else if (any_dirty) {
+            // Only re-render tiles whose name table entry, attribute, pattern or palette was written to
+            uint16_t pattern_offset = get_background_pattern_table() >> 4;
+
+            for (int i = 0; i < NR_OF_TILES; i++) {
+                if (tile_dirty[i] || pattern_dirty[pattern_offset + tile_pattern[i]] || palette_dirty[tile_palette[i]]) {
+                    fill_tile(i % FRAME_WIDTH, i / FRAME_WIDTH);
+                }
+            }
+        }
+
+        full_redraw = false;
+    }
+
+    if (any_dirty) {
+        memset(tile_dirty, 0, sizeof(tile_dirty));
+        memset(pattern_dirty, 0, sizeof(pattern_dirty));
+        memset(palette_dirty, 0, sizeof(palette_dirty));
+        any_dirty = false;
     }
 }
 
-void PPU::fill_quadrant(uint8_t upper_left_tile_x, uint8_t upper_left_tile_y, uint8_t palette_index) {
-    // Upper left tile
-    fill_tile(upper_left_tile_x, upper_left_tile_y, palette_index);
+uint8_t PPU::get_background_pixel(uint8_t x, uint8_t y) {
+    // Same lookup as fill_scanline, but for a single pixel
+    uint16_t world_y = (y + line_scroll_y[y] + (line_name_table[y] >> 1) * SCREEN_HEIGHT) % (SCREEN_HEIGHT * 2);
+    uint16_t world_x = (x + line_scroll_x[y] + (line_name_table[y] & 0b1) * SCREEN_WIDTH) % (SCREEN_WIDTH * 2);
 
-    // Upper right tile
-    fill_tile(upper_left_tile_x + 1, upper_left_tile_y, palette_index);
+    uint16_t name_table_address = get_name_table_address((world_y / SCREEN_HEIGHT) * 2 + world_x / SCREEN_WIDTH);
+    uint8_t tile_x = (world_x % SCREEN_WIDTH) / 8;
+    uint8_t tile_y = (world_y % SCREEN_HEIGHT) / 8;
 
-    // Lower left tile
-    fill_tile(upper_left_tile_x, upper_left_tile_y + 1, palette_index);
+    uint8_t pattern_table_index = bus->read_from_ppu(name_table_address + tile_y * FRAME_WIDTH + tile_x);
+    uint16_t pattern_address = get_background_pattern_table() + pattern_table_index * 16 + world_y % 8;
 
-    // Lower right tile
-    fill_tile(upper_left_tile_x + 1, upper_left_tile_y + 1, palette_index);
+    uint8_t shift = 7 - world_x % 8;
+    uint8_t lower = bus->read_from_ppu(pattern_address);
+    uint8_t upper = bus->read_from_ppu(pattern_address + 8);
+
+    return (((upper >> shift) & 0b1) << 1) | ((lower >> shift) & 0b1);
 }
 
-void PPU::fill_block(uint8_t block_nr) {
-    uint8_t attribute_byte = bus->read_from_ppu(ATTRIBUTE_TABLE_BOTTOM + block_nr);
+uint16_t PPU::get_sprite_pattern_address(uint8_t tile, uint8_t attributes, uint8_t row) {
+    if (attributes & 0x80) {
+        // Flip vertically
+        row = get_sprite_height() - 1 - row;
+    }
+
+    if (get_sprite_height() == 16) {
+        // 8x16 sprites pick their pattern table with bit 0 and use 2 consecutive tiles
+        uint16_t pattern_table = (tile & 0b1) ? 0x1000 : 0x0000;
+        tile = (tile & 0xFE) + (row >> 3);
 
-    uint8_t upper_left_tile_x = (block_nr * 4) % 32;
-    uint8_t upper_left_tile_y = (block_nr / 8) * 4;
+        return pattern_table + tile * 16 + (row & 0b111);
+    }
+
+    return ((control_1 & 0x08) ? 0x1000 : 0x0000) + tile * 16 + row;
+}
 
-    // Fill quadrant 0
-    fill_quadrant(upper_left_tile_x, upper_left_tile_y, attribute_byte & 0b11);
+void PPU::evaluate_sprites() {
+    memset(line_sprite_count, 0, SCREEN_HEIGHT);
+    overflow_scanline = NO_SCANLINE;
+    sprite_zero_hit_scanline = NO_SCANLINE;
 
-    // Fill quadrant 1
-    fill_quadrant(upper_left_tile_x + 2, upper_left_tile_y, attribute_byte & 0b1100);
+    uint8_t height = get_sprite_height();
 
-    // Fill quadrant 2
-    fill_quadrant(upper_left_tile_x, upper_left_tile_y + 2, attribute_byte & 0b110000);
+    for (uint8_t sprite_nr = 0; sprite_nr < NR_OF_SPRITES; sprite_nr++) {
+        // Sprites are drawn one line below their Y coordinate
+        uint16_t top = bus->read_from_spr_ram(sprite_nr * 4) + 1;
 
-    // Fill quadrant 3
-    fill_quadrant(upper_left_tile_x + 2, upper_left_tile_y + 2, attribute_byte & 0b11000000);
+        for (uint16_t y = top; y < top + height && y < SCREEN_HEIGHT; y++) {
+            if (line_sprite_count[y] < SPRITES_PER_SCANLINE) {
+                line_sprites[y][line_sprite_count[y]++] = sprite_nr;
+            } else if (y < overflow_scanline) {
+                overflow_scanline = y;
+            }
+        }
+    }
+}
+
+uint16_t PPU::find_sprite_zero_hit(uint8_t y) {
+    uint8_t top = bus->read_from_spr_ram(0) + 1;
+    uint8_t tile = bus->read_from_spr_ram(1);
+    uint8_t attributes = bus->read_from_spr_ram(2);
+    uint8_t left = bus->read_from_spr_ram(3);
+
+    uint16_t pattern_address = get_sprite_pattern_address(tile, attributes, y - top);
+    uint8_t lower = bus->read_from_ppu(pattern_address);
+    uint8_t upper = bus->read_from_ppu(pattern_address + 8);
+
+    // Only the 8 pixels of sprite 0 need to be checked against the background
+    for (uint8_t sprite_x = 0; sprite_x < 8; sprite_x++) {
+        uint16_t x = left + sprite_x;
+
+        // A hit never happens on the last pixel of a line
+        if (x >= SCREEN_WIDTH - 1) {
+            break;
+        }
+
+        // Pixels hidden by left column clipping can't hit
+        if (x < 8 && (control_2 & 0b110) != 0b110) {
+            continue;
+        }
+
+        uint8_t shift = (attributes & 0x40) ? sprite_x : 7 - sprite_x;
+        if (((upper >> shift) & 0b1) == 0 && ((lower >> shift) & 0b1) == 0) {
+            continue;
+        }
+
+        if (get_background_pixel(x, y) != 0) {
+            // Pixel x is output on dot x + 1
+            return x + 1;
+        }
+    }
+
+    return 0;
+}
+
+void PPU::fill_sprites(uint8_t y) {
+    // A pixel belongs to the first opaque sprite on it, even if that sprite is behind the background
+    bool covered[SCREEN_WIDTH] = {};
+    uint32_t* row = display + y * SCREEN_WIDTH;
+    uint8_t* opaque_row = background_opaque + y * SCREEN_WIDTH;
+    bool show_background = is_background_enabled();
+    bool clip_background = !(control_2 & 0b10);
+
+    for (uint8_t i = 0; i < line_sprite_count[y]; i++) {
+        uint8_t sprite_nr = line_sprites[y][i];
+        uint8_t top = bus->read_from_spr_ram(sprite_nr * 4) + 1;
+        uint8_t tile = bus->read_from_spr_ram(sprite_nr * 4 + 1);
+        uint8_t attributes = bus->read_from_spr_ram(sprite_nr * 4 + 2);
+        uint8_t left = bus->read_from_spr_ram(sprite_nr * 4 + 3);
+
+        uint16_t pattern_address = get_sprite_pattern_address(tile, attributes, y - top);
+        uint8_t lower = bus->read_from_ppu(pattern_address);
+        uint8_t upper = bus->read_from_ppu(pattern_address + 8);
+
+        bool behind_background = attributes & 0x20;
+        uint8_t palette_index = attributes & 0b11;
+
+        for (uint8_t sprite_x = 0; sprite_x < 8; sprite_x++) {
+            uint16_t x = left + sprite_x;
+
+            if (x >= SCREEN_WIDTH) {
+                break;
+            }
+
+            if (covered[x] || (x < 8 && !(control_2 & 0b100))) {
+                continue;
+            }
+
+            uint8_t shift = (attributes & 0x40) ? sprite_x : 7 - sprite_x;
+            uint8_t frame_palette_index = (((upper >> shift) & 0b1) << 1) | ((lower >> shift) & 0b1);
+
+            if (frame_palette_index == 0) {
+                continue;
+            }
+
+            covered[x] = true;
+
+            if (behind_background && show_background && opaque_row[x] && !(x < 8 && clip_background)) {
+                continue;
+            }
+
+            row[x] = sprite_colour(palette_index, frame_palette_index);
+        }
+    }
 }
 
 void PPU::draw() {
-    // Iterate over the 64 blocks
-    for (uint8_t block_nr = 0; block_nr < 64; block_nr++) {
+    ZONE("ppu draw");
+
+    if (palette_cache_dirty) {
+        update_palette_cache();
+    }
+
+    uint32_t backdrop = palette_cache[0];
 
-        for (uint8_t quadrant_nr = 0; quadrant_nr < 4; quadrant_nr++) {
-            fill_block(block_nr);
+    if (is_background_enabled()) {
+        update_background();
+
+        memcpy(display, background, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+
+        if (!(control_2 & 0b10)) {
+            // The background is hidden in the left 8 pixels
+            for (int y = 0; y < SCREEN_HEIGHT; y++) {
+                std::fill(display + y * SCREEN_WIDTH, display + y * SCREEN_WIDTH + 8, backdrop);
+            }
         }
+    } else {
+        std::fill(display, display + SCREEN_WIDTH * SCREEN_HEIGHT, backdrop);
     }
-}
\ No newline at end of file
+
+    if (are_sprites_enabled()) {
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            if (line_sprite_count[y] > 0) {
+                fill_sprites(y);
+            }
+        }
+    }
+}
+
+void PPU::mark_dirty(uint16_t address) {
+    if (address < PATTERN_TABLE_TOP) {
+        // 16 bytes per pattern
+        pattern_dirty[address >> 4] = true;
+
+    } else if (address < IMAGE_PALETTE_BOTTOM) {
+        // Writes to name tables other than the cached one don't matter until it is switched, which redraws anyway
+        if ((address & ~(NAME_TABLE_SIZE - 1)) != cached_name_table) {
+            return;
+        }
+
+        uint16_t offset = address & (NAME_TABLE_SIZE - 1);
+
+        if (offset < ATTRIBUTE_TABLE_OFFSET) {
+            tile_dirty[offset] = true;
+        } else {
+            // An attribute byte covers a block of 4x4 tiles; the last row of blocks is only half visible
+            uint8_t block_nr = offset - ATTRIBUTE_TABLE_OFFSET;
+            uint8_t upper_left_tile_x = (block_nr % 8) * 4;
+            uint8_t upper_left_tile_y = (block_nr / 8) * 4;
+
+            for (int y = upper_left_tile_y; y < upper_left_tile_y + 4 && y < FRAME_HEIGHT; y++) {
+                for (int x = upper_left_tile_x; x < upper_left_tile_x + 4; x++) {
+                    tile_dirty[y * FRAME_WIDTH + x] = true;
+                }
+            }
+        }
+
+    } else {
+        palette_cache_dirty = true;
+
+        if (address == IMAGE_PALETTE_BOTTOM) {
+            // The backdrop colour shows through every transparent background pixel
+            full_redraw = true;
+        } else if (address < SPRITE_PALETTE_BOTTOM) {
+            palette_dirty[(address & 0x0F) >> 2] = true;
+        }
+    }
+
+    any_dirty = true;
+}
+
+uint8_t PPU::read_register(uint16_t address) {
+    switch (address) {
+        case STATUS_REGISTER: {
+            uint8_t result = status;
+
+            // Reading the status clears the vblank flag and resets the $2005/$2006 latch
+            status &= 0x7F;
+            address_latch = false;
+
+            return result;
+        }
+
+        case SPR_RAM_IO_REGISTER: {
+            return bus->read_from_spr_ram(spr_ram_address);
+        }
+
+        case VRAM_IO_REGISTER: {
+            uint8_t result = read_buffer;
+            read_buffer = bus->read_from_ppu(vram_address);
+
+            // Palette reads are not delayed by the buffer
+            if (vram_address >= IMAGE_PALETTE_BOTTOM) {
+                result = read_buffer;
+            }
+
+            vram_address = (vram_address + ((control_1 & 0x04) ? 32 : 1)) & 0x3FFF;
+
+            return result;
+        }
+
+        default: {
+            return 0;
+        }
+    }
+}
+
+void PPU::write_register(uint16_t address, uint8_t value) {
+    switch (address) {
+        case CONTROL_REGISTER_1: {
+            if ((control_1 ^ value) & 0x10) {
+                // The background switched pattern tables
+                full_redraw = true;
+            }
+
+            if (!(control_1 & 0x80) && (value & 0x80) && (status & 0x80)) {
+                // Enabling NMI during vblank triggers it right away
+                bus->request_nmi();
+            }
+
+            control_1 = value;
+
+            break;
+        }
+
+        case CONTROL_REGISTER_2: {
+            if ((control_2 ^ value) & 0xE1) {
+                // Greyscale or emphasis changed, every colour changes with it
+                palette_cache_dirty = true;
+                full_redraw = true;
+            }
+
+            control_2 = value;
+
+            break;
+        }
+
+        case SPR_RAM_ADDRESS_REGISTER: {
+            spr_ram_address = value;
+
+            break;
+        }
+
+        case SPR_RAM_IO_REGISTER: {
+            bus->write_to_spr_ram(spr_ram_address++, value);
+
+            break;
+        }
+
+        case SCROLL_REGISTER: {
+            if (!address_latch) {
+                scroll_x = value;
+            } else {
+                scroll_y = value;
+            }
+
+            address_latch = !address_latch;
+
+            break;
+        }
+
+        case VRAM_ADDRESS_REGISTER: {
+            if (!address_latch) {
+                vram_address = ((value & 0x3F) << 8) | (vram_address & 0x00FF);
+            } else {
+                vram_address = (vram_address & 0xFF00) | value;
+            }
+
+            address_latch = !address_latch;
+
+            break;
+        }
+
+        case VRAM_IO_REGISTER: {
+            bus->write_to_ppu(vram_address, value);
+            vram_address = (vram_address + ((control_1 & 0x04) ? 32 : 1)) & 0x3FFF;
+
+            break;
+        }
+
+        default: {
+            break;
+        }
+    }
+}
+
+void PPU::step(uint16_t dots) {
+    dot += dots;
+
+    while (dot >= DOTS_PER_SCANLINE) {
+        dot -= DOTS_PER_SCANLINE;
+        next_scanline();
+    }
+
+    if (scanline == sprite_zero_hit_scanline && dot >= sprite_zero_hit_dot) {
+        status |= 0x40;
+        sprite_zero_hit_scanline = NO_SCANLINE;
+    }
+}
+
+void PPU::next_scanline() {
+    // Only a few hundred times a frame, cheap enough to always time
+    ScopedTimer timer(&render_ticks);
+    ZONE("ppu scanline");
+
+    if (scanline == sprite_zero_hit_scanline) {
+        // The hit happened somewhere on the line that just ended
+        status |= 0x40;
+        sprite_zero_hit_scanline = NO_SCANLINE;
+    }
+
+    scanline = (scanline + 1) % (PRE_RENDER_SCANLINE + 1);
+
+    if (scanline < SCREEN_HEIGHT) {
+        // Latch the scroll so split screens are rendered the way they were set up mid-frame
+        line_scroll_x[scanline] = scroll_x;
+        line_scroll_y[scanline] = scroll_y;
+        line_name_table[scanline] = control_1 & 0b11;
+
+        if (scanline == overflow_scanline) {
+            status |= 0x20;
+        }
+
+        // Sprite 0 is always first in the list of the lines it is on
+        bool sprite_zero_on_line = line_sprite_count[scanline] > 0 && line_sprites[scanline][0] == 0;
+
+        if (sprite_zero_on_line && !(status & 0x40) && sprite_zero_hit_scanline == NO_SCANLINE
+                && is_background_enabled() && are_sprites_enabled()) {
+            uint16_t hit_dot = find_sprite_zero_hit(scanline);
+
+            if (hit_dot != 0) {
+                sprite_zero_hit_scanline = scanline;
+                sprite_zero_hit_dot = hit_dot;
+            }
+        }
+
+    } else if (scanline == VBLANK_SCANLINE) {
+        status |= 0x80;
+
+        // Dirty tiles keep piling up over skipped frames, so the next drawn frame is still correct
+        frame_rendered = frame_skip != FRAME_SKIP_NEVER_RENDER && skipped_frames >= frame_skip;
+
+        if (frame_rendered) {
+            draw();
+            skipped_frames = 0;
+
+            // Hand the frame to the presenter and continue in a free buffer
+            frames->publish();
+            display = frames->get_back();
+        } else {
+            skipped_frames++;
+        }
+
+        frame_complete = true;
+        frame_number++;
+
+        if (control_1 & 0x80) {
+            bus->request_nmi();
+        }
+
+    } else if (scanline == PRE_RENDER_SCANLINE) {
+        // Clear vblank, sprite 0 hit and overflow
+        status &= 0x1F;
+
+        // SPR-RAM is normally written during vblank, so the next frame's sprites are known now
+        evaluate_sprites();
+    }
+}
@@ -3,21 +3,76 @@
 
 #include <cstring>
 #include <cstdint>
+#include <algorithm>
 
 #define FRAME_WIDTH 0x20
 #define FRAME_HEIGHT 0x1E
+#define SCREEN_WIDTH (FRAME_WIDTH * 8)
+#define SCREEN_HEIGHT (FRAME_HEIGHT * 8)
+#define NR_OF_TILES (FRAME_WIDTH * FRAME_HEIGHT)
+#define NR_OF_PATTERNS 0x200 // 256 tiles in each of the 2 pattern tables
+
+#define NR_OF_SPRITES 64
+#define SPRITES_PER_SCANLINE 8
+#define NO_SCANLINE 0xFFFF
+
+#define FRAME_SKIP_NEVER_RENDER 0xFF // Keep emulating but never compose a frame
+
+#define DOTS_PER_SCANLINE 341
+#define VBLANK_SCANLINE 241
+#define PRE_RENDER_SCANLINE 261
 
 #define ATTRIBUTE_TABLE_BOTTOM 0x23C0
+#define ATTRIBUTE_TABLE_OFFSET 0x3C0
 #define NAME_TABLE_BOTTOM 0x2000
+#define NAME_TABLE_SIZE 0x400
 #define PATTERN_TABLE_BOTTOM 0x0000
+#define PATTERN_TABLE_TOP 0x2000
 
 #define IMAGE_PALETTE_BOTTOM 0x3F00
 #define SPRITE_PALETTE_BOTTOM 0x3F10
+#define PALETTE_SIZE 0x20
 
 #define CONTROL_REGISTER_1 0x2000
 #define CONTROL_REGISTER_2 0x2001
+#define STATUS_REGISTER 0x2002
+#define SPR_RAM_ADDRESS_REGISTER 0x2003
+#define SPR_RAM_IO_REGISTER 0x2004
+#define SCROLL_REGISTER 0x2005
+#define VRAM_ADDRESS_REGISTER 0x2006
+#define VRAM_IO_REGISTER 0x2007
+
+// Registers and timing of the PPU; the background and palette caches are rebuilt after a restore instead
+struct PPUState {
+    uint8_t control_1;
+    uint8_t control_2;
+    uint8_t status;
+    uint8_t spr_ram_address;
+    uint8_t scroll_x;
+    uint8_t scroll_y;
+    uint16_t vram_address;
+    uint8_t read_buffer;
+    bool address_latch;
+
+    uint16_t scanline;
+    uint16_t dot;
+    bool frame_complete;
+    uint64_t frame_number;
+
+    uint8_t line_scroll_x[SCREEN_HEIGHT];
+    uint8_t line_scroll_y[SCREEN_HEIGHT];
+    uint8_t line_name_table[SCREEN_HEIGHT];
+
+    uint8_t line_sprites[SCREEN_HEIGHT][SPRITES_PER_SCANLINE];
+    uint8_t line_sprite_count[SCREEN_HEIGHT];
+    uint16_t overflow_scanline;
+    uint16_t sprite_zero_hit_scanline;
+    uint16_t sprite_zero_hit_dot;
+};
 
 #include "bus.h"
+#include "triple_buffer.h"
+#include "stats.h"
 
 /*
 uint32_t colour_palette[64] = {
@@ -65,24 +120,149 @@ private:
         0x9FFFF3, 0x000000, 0x000000, 0x000000
     };
 
-    // Display matrix
-    uint32_t** display;
+    // Completed frames are handed to the presenter through here
+    TripleBuffer* frames;
+
+    // Frame that is currently being drawn, the back buffer of frames
+    uint32_t* display;
+
+    // Cached background layer, only the tiles that changed are re-rendered into it
+    uint32_t* background;
+
+    // Whether each pixel of the background layer is opaque, needed for sprite priority
+    uint8_t* background_opaque;
+
+    uint8_t control_1;      // $2000
+    uint8_t control_2;      // $2001
+    uint8_t status;         // $2002
+    uint8_t spr_ram_address; // $2003
+    uint8_t scroll_x;       // First write to $2005
+    uint8_t scroll_y;       // Second write to $2005
+    uint16_t vram_address;  // Set through $2006
+    uint8_t read_buffer;    // $2007 reads are delayed by one read
+    bool address_latch;     // Toggles between the first and second write to $2005/$2006
+
+    uint16_t scanline;
+    uint16_t dot;
+    bool frame_complete;
+    uint64_t frame_number;
+
+    // Number of frames that are emulated without composing pixels after every rendered one
+    uint8_t frame_skip;
+    uint8_t skipped_frames;
+    bool frame_rendered;
+    uint64_t render_ticks; // Time spent on scanline work since the last reset
+
+    // Scroll and name table as they were when each visible scanline started
+    uint8_t line_scroll_x[SCREEN_HEIGHT];
+    uint8_t line_scroll_y[SCREEN_HEIGHT];
+    uint8_t line_name_table[SCREEN_HEIGHT];
+
+    // Dirty tracking for the cached background
+    bool full_redraw;
+    bool tile_dirty[NR_OF_TILES];
+    bool pattern_dirty[NR_OF_PATTERNS];
+    bool palette_dirty[4];
+    bool any_dirty;
+
+    // What each tile in the cache was last rendered with
+    uint8_t tile_pattern[NR_OF_TILES];
+    uint8_t tile_palette[NR_OF_TILES];
+
+    // Mirrored address of the name table that the cache holds
+    uint16_t cached_name_table;
+
+    // Sprites on each scanline in priority order, evaluated from SPR-RAM once per frame
+    uint8_t line_sprites[SCREEN_HEIGHT][SPRITES_PER_SCANLINE];
+    uint8_t line_sprite_count[SCREEN_HEIGHT];
+
+    // First scanline with more than 8 sprites on it, sets the overflow flag once reached
+    uint16_t overflow_scanline;
+
+    // Where sprite 0 first overlaps the background in the current frame
+    uint16_t sprite_zero_hit_scanline;
+    uint16_t sprite_zero_hit_dot;
+
+    uint16_t get_name_table_address(uint8_t name_table) { return NAME_TABLE_BOTTOM + name_table * NAME_TABLE_SIZE; }
+    uint16_t get_background_pattern_table() { return (control_1 & 0x10) ? 0x1000 : 0x0000; }
+    uint8_t get_sprite_height() { return (control_1 & 0x20) ? 16 : 8; }
+    bool is_background_enabled() { return control_2 & 0x08; }
+    bool are_sprites_enabled() { return control_2 & 0x10; }
+
+    // Palette RAM resolved to ARGB colours, with greyscale and emphasis from $2001 applied
+    uint32_t palette_cache[PALETTE_SIZE];
+    bool palette_cache_dirty;
+
+    // Rebuild the palette cache from palette RAM
+    void update_palette_cache();
+
+    // Look up the colour of a background or sprite pixel; pixel value 0 is always the backdrop
+    uint32_t background_colour(uint8_t palette_index, uint8_t pixel_value) { return pixel_value ? palette_cache[palette_index * 4 + pixel_value] : palette_cache[0]; }
+    uint32_t sprite_colour(uint8_t palette_index, uint8_t pixel_value) { return palette_cache[PALETTE_SIZE / 2 + palette_index * 4 + pixel_value]; }
 
     // Fill a block tile with the proper color values
-    void fill_tile(uint8_t tile_x, uint8_t tile_y, uint8_t palette_index);
+    void fill_tile(uint8_t tile_x, uint8_t tile_y);
+
+    // Render a single line of the background while taking its scroll into account
+    void fill_scanline(uint8_t y);
+
+    // Bring the cached background up to date with the PPU memory
+    void update_background();
+
+    // Value (0-3) of a single background pixel as it is shown on screen
+    uint8_t get_background_pixel(uint8_t x, uint8_t y);
+
+    // Address of the pattern row of a sprite, taking 8x16 sprites and vertical flipping into account
+    uint16_t get_sprite_pattern_address(uint8_t tile, uint8_t attributes, uint8_t row);
 
-    // Fill a block quadrant with the proper color values
-    void fill_quadrant(uint8_t upper_left_tile_x, uint8_t upper_left_tile_y, uint8_t palette_index);
+    // Build the per-scanline sprite lists from SPR-RAM
+    void evaluate_sprites();
 
-    // Fill a block with the proper color values
-    void fill_block(uint8_t block_nr);
+    // Find the dot on which sprite 0 hits the background on a scanline, 0 if it doesn't
+    uint16_t find_sprite_zero_hit(uint8_t y);
+
+    // Draw the sprites of a scanline over the background
+    void fill_sprites(uint8_t y);
+
+    // Advance to the next scanline and handle the events that happen on it
+    void next_scanline();
 public:
     PPU();
     ~PPU();
 
     void set_bus(Bus* bus_ptr) { this->bus = bus_ptr; }
+    void reset();
     void draw();
-    uint32_t** get_display() { return display; } 
+    TripleBuffer* get_frame_buffer() { return frames; }
+
+    // Frame skip settings and the frame buffers are not part of the state
+    void save_state(PPUState& state);
+    void load_state(const PPUState& state);
+
+    uint8_t read_register(uint16_t address);
+    void write_register(uint16_t address, uint8_t value);
+
+    // Called by the bus whenever PPU memory is written to
+    void mark_dirty(uint16_t address);
+
+    // Force the next draw to render the entire background again
+    void invalidate_background() { full_redraw = true; }
+
+    // Run the PPU for a number of dots; 3 dots pass for every CPU cycle
+    void step(uint16_t dots);
+
+    // Skipped frames still keep vblank, NMI, sprite 0 hit and overflow exact; only drawing is skipped
+    void set_frame_skip(uint8_t skip) { frame_skip = skip; }
+    uint8_t get_frame_skip() { return frame_skip; }
+    bool is_frame_rendered() { return frame_rendered; } // Whether the last completed frame was drawn
+    uint64_t get_render_ticks() { return render_ticks; }
+    void reset_render_ticks() { render_ticks = 0; }
+    uint64_t get_frame_number() { return frame_number; }
+
+    bool is_frame_complete() { return frame_complete; }
+    void clear_frame_complete() { frame_complete = false; }
+    uint16_t get_scanline() { return scanline; }
+    uint16_t get_dot() { return dot; }
 };
 
 #endif
\ No newline at end of file
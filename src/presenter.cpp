@@ -0,0 +1,92 @@
+#include "presenter.h"
+#include "instrumentation.h"
+
+Presenter::Presenter(SDL_Window* window, TripleBuffer* frames_ptr, bool vsync, Upscaler* upscaler_ptr, Hud* hud_ptr) {
+    frames = frames_ptr;
+    upscaler = upscaler_ptr;
+    hud = hud_ptr;
+    present_ticks.store(0);
+    presented_count.store(0);
+
+    width = upscaler ? upscaler->get_output_width() : SCREEN_WIDTH;
+    height = upscaler ? upscaler->get_output_height() : SCREEN_HEIGHT;
+    upscaled = upscaler ? new uint32_t[width * height] : nullptr;
+    texture = nullptr;
+
+    renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+
+    if (!renderer) {
+        std::cout << "Failed to create renderer" << std::endl;
+        return;
+    }
+
+    SDL_RenderSetLogicalSize(renderer, width, height);
+
+    texture = SDL_CreateTexture(renderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            width, height);
+}
+
+Presenter::~Presenter() {
+    if (texture) {
+        SDL_DestroyTexture(texture);
+    }
+
+    if (renderer) {
+        SDL_DestroyRenderer(renderer);
+    }
+
+    delete[] upscaled;
+
+    // Nobody may be left waiting for a present that won't come
+    wake();
+}
+
+bool Presenter::present() {
+    // Frames published in the meantime are skipped, only the newest one is shown
+    if (!frames->update_front()) {
+        return false;
+    }
+
+    // Without a renderer frames still count as shown, so vsync pacing doesn't hang
+    if (renderer) {
+        uint64_t start = read_timestamp();
+        ZONE("present");
+
+        // The front buffer belongs to this thread until the next update_front, so it can't tear
+        if (upscaler) {
+            upscaler->upscale(frames->get_front(), upscaled);
+            SDL_UpdateTexture(texture, nullptr, upscaled, width * sizeof(uint32_t));
+        } else {
+            SDL_UpdateTexture(texture, nullptr, frames->get_front(), SCREEN_WIDTH * sizeof(uint32_t));
+        }
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+
+        if (hud) {
+            hud->draw(renderer, upscaler ? upscaler->get_scale() : 1);
+        }
+
+        present_ticks.store(read_timestamp() - start, std::memory_order_relaxed);
+        {
+            // Blocks on the display refresh with vsync
+            ZONE("render present");
+            SDL_RenderPresent(renderer);
+        }
+    }
+
+    presented_count.fetch_add(1, std::memory_order_release);
+    presented_count.notify_one();
+
+    return true;
+}
+
+void Presenter::wait_for_present(uint32_t last_presented_count) {
+    presented_count.wait(last_presented_count, std::memory_order_acquire);
+}
+
+void Presenter::wake() {
+    presented_count.fetch_add(1, std::memory_order_release);
+    presented_count.notify_all();
+}
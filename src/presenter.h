@@ -0,0 +1,48 @@
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include <atomic>
+#include <iostream>
+
+#include "SDL2/SDL.h"
+#include "ppu.h"
+#include "triple_buffer.h"
+#include "upscaler.h"
+#include "stats.h"
+#include "hud.h"
+
+// Uploads the newest completed frame to the window. SDL only supports rendering on the thread that
+// created the window, so this lives on the main thread while emulation runs on a thread of its own;
+// the triple buffer means a slow compositor or vsync never holds up emulation.
+class Presenter {
+private:
+    TripleBuffer* frames;
+    Upscaler* upscaler; // Optional, frames are shown as is without one
+    Hud* hud; // Optional overlay
+
+    SDL_Renderer* renderer;
+    SDL_Texture* texture;
+    uint32_t width;
+    uint32_t height;
+    uint32_t* upscaled; // Upscaled frames go through a buffer of their own
+
+    // Time taken to upscale, upload and draw the last frame, waiting for vsync not included
+    std::atomic<uint64_t> present_ticks;
+
+    // Number of frames shown so far, lets the emulation thread sync to vsync
+    std::atomic<uint32_t> presented_count;
+public:
+    // Must be created, used and deleted on the thread that created the window
+    Presenter(SDL_Window* window, TripleBuffer* frames_ptr, bool vsync, Upscaler* upscaler_ptr = nullptr, Hud* hud_ptr = nullptr);
+    ~Presenter();
+
+    bool present(); // Show the newest frame, returns false if nothing new was published
+
+    // Any thread
+    uint64_t get_present_ticks() { return present_ticks.load(std::memory_order_relaxed); }
+    uint32_t get_presented_count() { return presented_count.load(std::memory_order_acquire); }
+    void wait_for_present(uint32_t last_presented_count); // Sleep until a frame after last_presented_count is shown
+    void wake(); // Release a thread blocked in wait_for_present, used when shutting down
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#define MAIN_KEY 0xFFFFFFFF
+
+Profiler::Profiler(uint32_t interval) {
+    this->interval = interval > 0 ? interval : 1;
+    clear();
+}
+
+void Profiler::clear() {
+    nodes.clear();
+    children.clear();
+    nodes.push_back({0, MAIN_KEY, 0});
+
+    reset_call_stack();
+
+    until_sample = interval;
+    total_samples = 0;
+}
+
+void Profiler::reset_call_stack() {
+    call_stack.clear();
+    call_stack.push_back({0, 0xFF});
+}
+
+void Profiler::enter(uint16_t address, CallType type, uint8_t SP) {
+    uint32_t parent = call_stack.back().node;
+
+    if (call_stack.size() >= PROFILER_MAX_DEPTH) {
+        // Still tracked so the matching return pops the right frame
+        call_stack.push_back({parent, SP});
+        return;
+    }
+
+    uint32_t key = ((uint32_t) type << 16) | address;
+    auto [child, inserted] = children.try_emplace(((uint64_t) parent << 32) | key, (uint32_t) nodes.size());
+
+    if (inserted) {
+        nodes.push_back({parent, key, 0});
+    }
+
+    call_stack.push_back({child->second, SP});
+}
+
+void Profiler::leave(uint8_t SP) {
+    // Every frame whose return address is now above the stack pointer has returned. This also unwinds frames
+    // that were left by popping the return address manually, and ignores RTS used as an indirect jump.
+    while (call_stack.size() > 1 && call_stack.back().SP < SP) {
+        call_stack.pop_back();
+    }
+}
+
+void Profiler::take_samples(uint32_t cycles) {
+    cycles -= until_sample;
+
+    uint32_t samples = 1 + cycles / interval;
+    until_sample = interval - cycles % interval;
+
+    nodes[call_stack.back().node].samples += samples;
+    total_samples += samples;
+}
+
+std::string Profiler::get_name(uint32_t key) {
+    if (key == MAIN_KEY) {
+        return "main";
+    }
+
+    const char* prefixes[] = {"sub", "NMI", "IRQ"};
+    char name[16];
+    snprintf(name, sizeof(name), "%s_%04X", prefixes[key >> 16], key & 0xFFFF);
+
+    return name;
+}
+
+std::string Profiler::get_stack(uint32_t node) {
+    std::string stack = get_name(nodes[node].key);
+
+    while (node != 0) {
+        node = nodes[node].parent;
+        stack = get_name(nodes[node].key) + ";" + stack;
+    }
+
+    return stack;
+}
+
+bool Profiler::write_folded(const char* path) {
+    std::ofstream output(path);
+
+    for (uint32_t node = 0; node < nodes.size(); node++) {
+        if (nodes[node].samples > 0) {
+            output << get_stack(node) << " " << nodes[node].samples << "\n";
+        }
+    }
+
+    if (!output) {
+        std::cout << "Failed to write the profile " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Profiler::print_summary(std::ostream& output, size_t nr_of_entries) {
+    struct Entry {
+        uint32_t key;
+        uint64_t self;
+        uint64_t inclusive;
+    };
+
+    std::unordered_map<uint32_t, Entry> entries;
+    std::vector<uint32_t> seen;
+
+    for (uint32_t node = 0; node < nodes.size(); node++) {
+        uint64_t samples = nodes[node].samples;
+        if (samples == 0) {
+            continue;
+        }
+
+        entries.try_emplace(nodes[node].key, Entry{nodes[node].key, 0, 0}).first->second.self += samples;
+
+        // Recursive subroutines only count once towards their inclusive time
+        seen.clear();
+        for (uint32_t ancestor = node; ; ancestor = nodes[ancestor].parent) {
+            uint32_t key = nodes[ancestor].key;
+
+            if (std::find(seen.begin(), seen.end(), key) == seen.end()) {
+                seen.push_back(key);
+                entries.try_emplace(key, Entry{key, 0, 0}).first->second.inclusive += samples;
+            }
+
+            if (ancestor == 0) {
+                break;
+            }
+        }
+    }
+
+    std::vector<Entry> sorted;
+    for (const auto& entry : entries) {
+        sorted.push_back(entry.second);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return a.self > b.self || (a.self == b.self && a.key < b.key); });
+
+    output << total_samples << " samples, one every " << interval << " cycles" << std::endl;
+    output << "  self %  incl %  subroutine" << std::endl;
+
+    for (size_t i = 0; i < std::min(nr_of_entries, sorted.size()); i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "  %6.2f  %6.2f  ", sorted[i].self * 100.0 / total_samples, sorted[i].inclusive * 100.0 / total_samples);
+        output << line << get_name(sorted[i].key) << std::endl;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#define PROFILER_DEFAULT_INTERVAL 100 // CPU cycles between samples, about 300 samples per frame
+#define PROFILER_MAX_DEPTH 128 // Deeper calls are counted against the deepest tracked subroutine
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+
+enum CallType { CallSubroutine, CallNMI, CallIRQ };
+
+// Guest profiler: follows the 6502 call stack through JSR/RTS and interrupts/RTI and takes a sample of it every
+// interval CPU cycles. The samples are written as folded stacks ("main;sub_C123;sub_C456 42") for flamegraph tools.
+// Meant for straight runs, restoring a snapshot while profiling leaves the tracked call stack behind.
+class Profiler {
+private:
+    // One node for every distinct call stack seen, so a sample is a single increment
+    struct CallNode {
+        uint32_t parent;
+        uint32_t key; // Entry address, with the CallType above it
+        uint64_t samples;
+    };
+
+    struct Frame {
+        uint32_t node;
+        uint8_t SP; // Stack pointer right after the return address was pushed
+    };
+
+    std::vector<CallNode> nodes; // Node 0 is the main program
+    std::unordered_map<uint64_t, uint32_t> children; // (parent, key) to node
+    std::vector<Frame> call_stack;
+
+    uint32_t interval;
+    uint32_t until_sample; // Cycles left until the next sample
+    uint64_t total_samples;
+
+    void take_samples(uint32_t cycles);
+    std::string get_name(uint32_t key);
+    std::string get_stack(uint32_t node);
+
+public:
+    Profiler(uint32_t interval = PROFILER_DEFAULT_INTERVAL);
+
+    void enter(uint16_t address, CallType type, uint8_t SP); // A subroutine or interrupt handler was entered
+    void leave(uint8_t SP); // An RTS or RTI popped its return address
+    void reset_call_stack(); // Back to the main program, as after a reset
+
+    // Called after every instruction, so the common case is a compare and a subtraction
+    void add_cycles(uint32_t cycles) {
+        if (cycles < until_sample) {
+            until_sample -= cycles;
+            return;
+        }
+
+        take_samples(cycles);
+    }
+
+    uint32_t get_interval() { return interval; }
+    uint64_t get_total_samples() { return total_samples; }
+    void clear();
+
+    bool write_folded(const char* path);
+    void print_summary(std::ostream& output, size_t nr_of_entries); // Subroutines taking the most time, self and inclusive
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "rate_control.h"
+
+RateControl::RateControl(double sample_rate, double target_latency) {
+    this->sample_rate = sample_rate;
+    target_fill = sample_rate * target_latency;
+    smoothed_fill = target_fill;
+    drift = 0;
+    ratio = 1;
+}
+
+RateControl::~RateControl() {}
+
+double RateControl::update(uint32_t fill) {
+    smoothed_fill += FILL_SMOOTHING * (fill - smoothed_fill);
+
+    // Proportional to how far off the target the buffer is, an empty buffer gets the full adjustment
+    double error = (target_fill - smoothed_fill) / target_fill;
+    if (error > 1) {
+        error = 1;
+    } else if (error < -1) {
+        error = -1;
+    }
+
+    // Without this a constant clock difference would leave the buffer settled off the target
+    drift += error * RATE_INTEGRAL_GAIN;
+    if (drift > MAX_RATE_ADJUSTMENT) {
+        drift = MAX_RATE_ADJUSTMENT;
+    } else if (drift < -MAX_RATE_ADJUSTMENT) {
+        drift = -MAX_RATE_ADJUSTMENT;
+    }
+
+    double adjustment = error * MAX_RATE_ADJUSTMENT + drift;
+    if (adjustment > MAX_RATE_ADJUSTMENT) {
+        adjustment = MAX_RATE_ADJUSTMENT;
+    } else if (adjustment < -MAX_RATE_ADJUSTMENT) {
+        adjustment = -MAX_RATE_ADJUSTMENT;
+    }
+
+    ratio = 1 + adjustment;
+    return sample_rate * ratio;
+}
@@ -0,0 +1,32 @@
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+#include <cstdint>
+
+#define AUDIO_TARGET_LATENCY 0.032 // Seconds of audio to keep buffered
+#define MAX_RATE_ADJUSTMENT 0.005 // Largest change of the resampling ratio, far below what's audible as pitch
+#define FILL_SMOOTHING 0.05 // Weight of the newest fill level in its running average
+#define RATE_INTEGRAL_GAIN 0.00005 // Per update; takes out the constant offset between the two clocks
+
+// Dynamic rate control. Emulation is paced by video, so it never runs at exactly the rate the
+// audio device consumes samples. Rather than letting the buffer run dry or pile up latency, the
+// number of samples produced per emulated second is nudged to keep the buffer at the target fill.
+class RateControl {
+private:
+    double sample_rate;
+    double target_fill; // In samples
+    double smoothed_fill; // Fill levels saw-tooth with every frame and callback, so they're averaged
+    double drift; // Accumulated correction for the steady difference between the clocks
+    double ratio;
+public:
+    RateControl(double sample_rate, double target_latency);
+    ~RateControl();
+
+    double update(uint32_t fill); // Returns the sample rate to produce the next frame at
+
+    double get_ratio() { return ratio; }
+    double get_target_fill() { return target_fill; }
+    double get_smoothed_fill() { return smoothed_fill; }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "rom_batch.h"
+
+#include <iostream>
+#include <filesystem>
+
+static bool is_rom_file(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".nes";
+}
+
+std::vector<std::string> collect_roms(const std::vector<std::string>& inputs) {
+    std::vector<std::string> rom_paths;
+
+    for (const std::string& input : inputs) {
+        if (!std::filesystem::is_directory(input)) {
+            rom_paths.push_back(input);
+            continue;
+        }
+
+        // A directory that can't be read is reported and skipped, the rest of the set is still worth running
+        std::error_code error;
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+
+        for (auto it = std::filesystem::recursive_directory_iterator(input, options, error); it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (error) {
+                break;
+            }
+
+            if (it->is_regular_file(error) && is_rom_file(it->path())) {
+                rom_paths.push_back(it->path().string());
+            }
+        }
+
+        if (error) {
+            std::cerr << "Could not read " << input << ": " << error.message() << std::endl;
+        }
+    }
+
+    std::sort(rom_paths.begin(), rom_paths.end());
+
+    return rom_paths;
+}
@@ -0,0 +1,45 @@
+#ifndef ROM_BATCH_H
+#define ROM_BATCH_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+// Helpers for the tools that work through a whole set of ROMs at once
+
+// Swallows the core's logging while several ROMs are handled at the same time
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// The ROMs named in inputs plus every .nes file under the directories named there, sorted so reports of
+// different runs can be diffed
+std::vector<std::string> collect_roms(const std::vector<std::string>& inputs);
+
+// Calls work(index) for every index below count on up to nr_of_jobs threads, each thread keeps taking the next
+// index until they're all done. Returns the number of threads used.
+template <typename Work>
+unsigned int parallel_for_each(size_t count, unsigned int nr_of_jobs, Work work) {
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+
+    for (unsigned int i = 0; i < std::min<size_t>(nr_of_jobs, count); i++) {
+        workers.emplace_back([&] {
+            for (size_t index = next++; index < count; index = next++) {
+                work(index);
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return workers.size();
+}
+
+#endif
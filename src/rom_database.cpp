@@ -0,0 +1,132 @@
+#include "rom_database.h"
+
+#include <algorithm>
+
+// NES 2.0 stores RAM sizes as 64 << shift bytes, 0 meaning none
+static uint8_t size_to_shift(uint32_t size) {
+    uint8_t shift = 0;
+
+    while (shift < 15 && (64u << shift) < size) {
+        shift++;
+    }
+
+    return size == 0 ? 0 : shift;
+}
+
+static uint32_t shift_to_size(uint8_t shift) {
+    return shift == 0 ? 0 : 64u << (shift & 0x0F);
+}
+
+RomDatabase::RomDatabase() {}
+
+RomDatabase::~RomDatabase() {}
+
+bool RomDatabase::load(const char* path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        std::cout << "Failed to open the ROM database " << path << std::endl;
+        return false;
+    }
+
+    uint8_t header[ROM_DATABASE_HEADER_SIZE];
+    input.read((char*) header, ROM_DATABASE_HEADER_SIZE);
+
+    if (!input || memcmp(header, ROM_DATABASE_MAGIC, 4) != 0 || header[4] != ROM_DATABASE_VERSION) {
+        std::cout << "Invalid ROM database " << path << std::endl;
+        return false;
+    }
+
+    uint32_t count = 0;
+    for (int i = 0; i < 4; i++) {
+        count |= header[8 + i] << (8 * i);
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    if (data.size() != (size_t) count * ROM_DATABASE_ENTRY_SIZE) {
+        std::cout << "The ROM database " << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    entries.resize(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* record = data.data() + i * ROM_DATABASE_ENTRY_SIZE;
+        RomDatabaseEntry& entry = entries[i];
+
+        entry.crc = record[0] | (record[1] << 8) | (record[2] << 16) | ((uint32_t) record[3] << 24);
+        entry.mapper_number = record[4] | (record[5] << 8);
+        entry.submapper = record[6];
+        entry.mirroring = record[7];
+        entry.battery_backed_ram = record[8] & 0x01;
+        entry.prg_ram_size = shift_to_size(record[9]);
+        entry.prg_nvram_size = shift_to_size(record[10]);
+        entry.chr_ram_size = shift_to_size(record[11]);
+
+        // Lookups rely on the order
+        if (i > 0 && entries[i - 1].crc >= entry.crc) {
+            std::cout << "The ROM database " << path << " isn't sorted" << std::endl;
+            entries.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool RomDatabase::save(const char* path) {
+    std::ofstream output(path, std::ios::binary);
+
+    uint8_t header[ROM_DATABASE_HEADER_SIZE] = {};
+    memcpy(header, ROM_DATABASE_MAGIC, 4);
+    header[4] = ROM_DATABASE_VERSION;
+
+    for (int i = 0; i < 4; i++) {
+        header[8 + i] = (entries.size() >> (8 * i)) & 0xFF;
+    }
+
+    output.write((const char*) header, ROM_DATABASE_HEADER_SIZE);
+
+    for (const RomDatabaseEntry& entry : entries) {
+        uint8_t record[ROM_DATABASE_ENTRY_SIZE] = {
+            (uint8_t) entry.crc, (uint8_t) (entry.crc >> 8), (uint8_t) (entry.crc >> 16), (uint8_t) (entry.crc >> 24),
+            (uint8_t) entry.mapper_number, (uint8_t) (entry.mapper_number >> 8),
+            entry.submapper,
+            entry.mirroring,
+            (uint8_t) entry.battery_backed_ram,
+            size_to_shift(entry.prg_ram_size),
+            size_to_shift(entry.prg_nvram_size),
+            size_to_shift(entry.chr_ram_size)
+        };
+
+        output.write((const char*) record, ROM_DATABASE_ENTRY_SIZE);
+    }
+
+    if (!output) {
+        std::cout << "Failed to write the ROM database " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void RomDatabase::add(const RomDatabaseEntry& entry) {
+    auto position = std::lower_bound(entries.begin(), entries.end(), entry.crc, [](const RomDatabaseEntry& a, uint32_t crc) { return a.crc < crc; });
+
+    if (position != entries.end() && position->crc == entry.crc) {
+        *position = entry;
+    } else {
+        entries.insert(position, entry);
+    }
+}
+
+bool RomDatabase::find(uint32_t crc, RomDatabaseEntry& entry) const {
+    auto position = std::lower_bound(entries.begin(), entries.end(), crc, [](const RomDatabaseEntry& a, uint32_t crc) { return a.crc < crc; });
+
+    if (position == entries.end() || position->crc != crc) {
+        return false;
+    }
+
+    entry = *position;
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef ROM_DATABASE_H
+#define ROM_DATABASE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#define ROM_DATABASE_MAGIC "NSDB"
+#define ROM_DATABASE_VERSION 1
+#define ROM_DATABASE_HEADER_SIZE 12 // Magic, version and the number of entries
+#define ROM_DATABASE_ENTRY_SIZE 12 // RAM sizes are stored as NES 2.0 shift counts
+
+enum Mirroring { HorizontalMirroring, VerticalMirroring, FourScreenMirroring };
+
+// What a good dump's header should say, for the ROM whose PRG-ROM and CHR-ROM have this CRC-32
+struct RomDatabaseEntry {
+    uint32_t crc;
+    uint16_t mapper_number;
+    uint8_t submapper;
+    uint8_t mirroring; // A Mirroring
+    bool battery_backed_ram;
+    uint32_t prg_ram_size; // In bytes, volatile and battery backed separately
+    uint32_t prg_nvram_size;
+    uint32_t chr_ram_size;
+};
+
+// Header corrections for badly dumped ROMs. On disk it's a small header followed by fixed size little endian
+// entries sorted by CRC, so the whole file is read in one go and looked up with a binary search.
+class RomDatabase {
+private:
+    std::vector<RomDatabaseEntry> entries; // Sorted by CRC
+public:
+    RomDatabase();
+    ~RomDatabase();
+
+    bool load(const char* path);
+    bool save(const char* path);
+
+    void add(const RomDatabaseEntry& entry); // Replaces an entry with the same CRC
+    bool find(uint32_t crc, RomDatabaseEntry& entry) const;
+    size_t get_size() const { return entries.size(); }
+};
+
+#endif
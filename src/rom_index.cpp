@@ -0,0 +1,164 @@
+#include "rom_index.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#define FLAG_NES2 0x01
+#define FLAG_BATTERY 0x02
+#define FLAG_FROM_DATABASE 0x04
+
+static void write_le(uint8_t* output, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        output[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint64_t read_le(const uint8_t* input, int size) {
+    uint64_t value = 0;
+
+    for (int i = 0; i < size; i++) {
+        value |= (uint64_t) input[i] << (8 * i);
+    }
+
+    return value;
+}
+
+RomIndex::RomIndex() {}
+
+RomIndex::~RomIndex() {}
+
+bool RomIndex::load(const char* path) {
+    // Checked before opening, a directory has no size to read and opening a pipe blocks
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        std::cout << "Failed to open the ROM index " << path << std::endl;
+        return false;
+    }
+
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    std::streamoff size = input ? (std::streamoff) input.tellg() : -1;
+
+    if (size < 0) {
+        std::cout << "Failed to open the ROM index " << path << std::endl;
+        return false;
+    }
+
+    // One read for the whole file
+    std::vector<uint8_t> data(size);
+    input.seekg(0);
+    input.read((char*) data.data(), data.size());
+
+    if (!input || data.size() < ROM_INDEX_HEADER_SIZE || memcmp(data.data(), ROM_INDEX_MAGIC, 4) != 0 || data[4] != ROM_INDEX_VERSION) {
+        std::cout << "Invalid ROM index " << path << std::endl;
+        return false;
+    }
+
+    uint32_t count = read_le(data.data() + 8, 4);
+    uint32_t paths_size = read_le(data.data() + 12, 4);
+
+    if (data.size() != ROM_INDEX_HEADER_SIZE + (uint64_t) count * ROM_INDEX_ENTRY_SIZE + paths_size) {
+        std::cout << "The ROM index " << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    const char* paths = (const char*) data.data() + ROM_INDEX_HEADER_SIZE + (size_t) count * ROM_INDEX_ENTRY_SIZE;
+
+    std::vector<RomIndexEntry> loaded(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* record = data.data() + ROM_INDEX_HEADER_SIZE + i * ROM_INDEX_ENTRY_SIZE;
+        RomIndexEntry& entry = loaded[i];
+
+        uint32_t path_offset = read_le(record, 4);
+        uint32_t path_length = read_le(record + 4, 4);
+
+        if ((uint64_t) path_offset + path_length > paths_size || record[20] > RomUnreadable) {
+            std::cout << "The ROM index " << path << " is corrupt" << std::endl;
+            return false;
+        }
+
+        entry.path.assign(paths + path_offset, path_length);
+        entry.crc = read_le(record + 8, 4);
+        entry.mapper_number = read_le(record + 12, 2);
+        entry.nr_prg_rom_banks = read_le(record + 14, 2);
+        entry.nr_chr_rom_banks = read_le(record + 16, 2);
+        entry.submapper = record[18];
+        entry.mirroring = record[19];
+        entry.status = record[20];
+        entry.nes2 = record[21] & FLAG_NES2;
+        entry.battery_backed_ram = record[21] & FLAG_BATTERY;
+        entry.from_database = record[21] & FLAG_FROM_DATABASE;
+        entry.prg_ram_size = read_le(record + 24, 4);
+        entry.prg_nvram_size = read_le(record + 28, 4);
+        entry.chr_ram_size = read_le(record + 32, 4);
+        entry.file_size = read_le(record + 36, 8);
+        entry.modification_time = read_le(record + 44, 8);
+    }
+
+    // Written sorted, but a lookup on a hand-made file shouldn't silently fail
+    set_entries(std::move(loaded));
+    return true;
+}
+
+bool RomIndex::save(const char* path) {
+    std::vector<uint8_t> data(ROM_INDEX_HEADER_SIZE + entries.size() * ROM_INDEX_ENTRY_SIZE);
+    std::string paths;
+
+    memcpy(data.data(), ROM_INDEX_MAGIC, 4);
+    data[4] = ROM_INDEX_VERSION;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        const RomIndexEntry& entry = entries[i];
+        uint8_t* record = data.data() + ROM_INDEX_HEADER_SIZE + i * ROM_INDEX_ENTRY_SIZE;
+
+        write_le(record, paths.size(), 4);
+        write_le(record + 4, entry.path.size(), 4);
+        paths += entry.path;
+
+        write_le(record + 8, entry.crc, 4);
+        write_le(record + 12, entry.mapper_number, 2);
+        write_le(record + 14, entry.nr_prg_rom_banks, 2);
+        write_le(record + 16, entry.nr_chr_rom_banks, 2);
+        record[18] = entry.submapper;
+        record[19] = entry.mirroring;
+        record[20] = entry.status;
+        record[21] = (entry.nes2 ? FLAG_NES2 : 0) | (entry.battery_backed_ram ? FLAG_BATTERY : 0) | (entry.from_database ? FLAG_FROM_DATABASE : 0);
+        write_le(record + 24, entry.prg_ram_size, 4);
+        write_le(record + 28, entry.prg_nvram_size, 4);
+        write_le(record + 32, entry.chr_ram_size, 4);
+        write_le(record + 36, entry.file_size, 8);
+        write_le(record + 44, entry.modification_time, 8);
+    }
+
+    write_le(data.data() + 8, entries.size(), 4);
+    write_le(data.data() + 12, paths.size(), 4);
+
+    std::ofstream output(path, std::ios::binary);
+    output.write((const char*) data.data(), data.size());
+    output.write(paths.data(), paths.size());
+
+    if (!output) {
+        std::cout << "Failed to write the ROM index " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void RomIndex::set_entries(std::vector<RomIndexEntry>&& new_entries) {
+    entries = std::move(new_entries);
+
+    if (!std::is_sorted(entries.begin(), entries.end(), [](const RomIndexEntry& a, const RomIndexEntry& b) { return a.path < b.path; })) {
+        std::sort(entries.begin(), entries.end(), [](const RomIndexEntry& a, const RomIndexEntry& b) { return a.path < b.path; });
+    }
+}
+
+const RomIndexEntry* RomIndex::find(const std::string& path) const {
+    auto position = std::lower_bound(entries.begin(), entries.end(), path, [](const RomIndexEntry& a, const std::string& path) { return a.path < path; });
+
+    if (position == entries.end() || position->path != path) {
+        return nullptr;
+    }
+
+    return &*position;
+}
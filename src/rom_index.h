@@ -0,0 +1,55 @@
+#ifndef ROM_INDEX_H
+#define ROM_INDEX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#define ROM_INDEX_MAGIC "NSIX"
+#define ROM_INDEX_VERSION 1
+#define ROM_INDEX_HEADER_SIZE 16 // Magic, version, number of entries and size of the path table
+#define ROM_INDEX_ENTRY_SIZE 52
+
+enum RomStatus { RomValid, RomInvalidHeader, RomTruncated, RomUnreadable };
+
+// What a frontend needs to know about a ROM file without opening it
+struct RomIndexEntry {
+    std::string path;
+    uint8_t status; // A RomStatus, the fields below are only filled in for valid ROMs
+    bool nes2;
+    bool battery_backed_ram;
+    bool from_database; // The header was corrected by a RomDatabase
+    uint32_t crc; // Of PRG-ROM and CHR-ROM, as in RomDatabase
+    uint16_t mapper_number;
+    uint8_t submapper;
+    uint8_t mirroring; // A Mirroring
+    uint16_t nr_prg_rom_banks;
+    uint16_t nr_chr_rom_banks;
+    uint32_t prg_ram_size;
+    uint32_t prg_nvram_size;
+    uint32_t chr_ram_size;
+    uint64_t file_size; // Size and modification time tell whether the file changed since it was indexed
+    int64_t modification_time;
+};
+
+// Metadata of a whole ROM library. On disk it's a header, fixed size little endian entries sorted by path and one
+// table with all paths, so loading it is a single read and a pass over the entries.
+class RomIndex {
+private:
+    std::vector<RomIndexEntry> entries;
+public:
+    RomIndex();
+    ~RomIndex();
+
+    bool load(const char* path);
+    bool save(const char* path);
+
+    void set_entries(std::vector<RomIndexEntry>&& new_entries); // Sorts them by path
+    const std::vector<RomIndexEntry>& get_entries() const { return entries; }
+    const RomIndexEntry* find(const std::string& path) const;
+};
+
+#endif
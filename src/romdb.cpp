@@ -0,0 +1,153 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "cartridge.h"
+#include "rom_database.h"
+#include "crc32.h"
+
+static const char* mirroring_names = "HV4"; // Indexed by Mirroring
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " identify <rom>... [--db path]" << std::endl;
+    std::cerr << "       " << program << " build <listing> <database>" << std::endl;
+}
+
+// Listing lines look like "1a2b3c4d 4 0 V 8192 0 0 1", the CRC-32 of PRG-ROM and CHR-ROM, mapper, submapper,
+// mirroring (H, V or 4), PRG-RAM, battery backed PRG-RAM and CHR-RAM in bytes, and whether there's a battery
+static bool parse_listing_line(const std::string& line, RomDatabaseEntry& entry) {
+    std::stringstream fields(line);
+    uint32_t mapper_number, submapper, battery;
+    char mirroring;
+
+    fields >> std::hex >> entry.crc >> std::dec >> mapper_number >> submapper >> mirroring
+           >> entry.prg_ram_size >> entry.prg_nvram_size >> entry.chr_ram_size >> battery;
+
+    if (!fields || mapper_number > 0xFFF || submapper > 0x0F || !memchr(mirroring_names, mirroring, 3)) {
+        return false;
+    }
+
+    entry.mapper_number = mapper_number;
+    entry.submapper = submapper;
+    entry.mirroring = (const char*) memchr(mirroring_names, mirroring, 3) - mirroring_names;
+    entry.battery_backed_ram = battery != 0;
+
+    return true;
+}
+
+static int build(const char* listing_path, const char* database_path) {
+    std::ifstream listing(listing_path);
+    if (!listing) {
+        std::cerr << "Could not open " << listing_path << std::endl;
+        return 1;
+    }
+
+    RomDatabase database;
+    std::string line;
+    uint32_t line_number = 0;
+
+    while (std::getline(listing, line)) {
+        line_number++;
+
+        // Everything after a # is a comment, usually the name of the game
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        RomDatabaseEntry entry;
+        if (!parse_listing_line(line, entry)) {
+            std::cerr << listing_path << ":" << line_number << ": invalid entry" << std::endl;
+            return 1;
+        }
+
+        database.add(entry);
+    }
+
+    if (!database.save(database_path)) {
+        return 1;
+    }
+
+    std::cerr << database.get_size() << " ROMs written to " << database_path << std::endl;
+    return 0;
+}
+
+// Prints a listing line for every ROM, so good dumps can be turned into a database
+static int identify(const std::vector<const char*>& rom_paths, const char* database_path) {
+    RomDatabase database;
+    if (database_path && !database.load(database_path)) {
+        return 1;
+    }
+
+    int result = 0;
+
+    for (const char* rom_path : rom_paths) {
+        std::ifstream input(rom_path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+        // The cartridge logs to stdout, which carries the listing
+        std::cout.setstate(std::ios::failbit);
+        Cartridge cartridge = Cartridge(data.data(), data.size());
+        std::cout.clear();
+
+        if (!cartridge.is_valid_header() || data.size() < cartridge.get_rom_size()) {
+            std::cerr << "Invalid ROM " << rom_path << (cartridge.get_error().empty() ? "" : ": " + cartridge.get_error()) << std::endl;
+            result = 1;
+            continue;
+        }
+
+        size_t offset = INES_HEADER_SIZE + (cartridge.has_trainer() ? TRAINER_SIZE : 0);
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t crc = crc32(data.data() + offset, cartridge.get_rom_size() - offset);
+        double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        RomDatabaseEntry entry;
+        bool found = database_path && database.find(crc, entry);
+        if (found) {
+            cartridge.apply_database_entry(entry);
+        }
+
+        uint8_t mirroring = cartridge.has_four_screen_mirroring() ? FourScreenMirroring : (cartridge.get_mirror_type() ? VerticalMirroring : HorizontalMirroring);
+
+        std::cout << std::hex << std::setw(8) << std::setfill('0') << crc << std::dec << " " << cartridge.get_mapper_number() << " "
+                  << (int) cartridge.get_submapper() << " " << mirroring_names[mirroring] << " " << cartridge.get_prg_ram_size() << " "
+                  << cartridge.get_prg_nvram_size() << " " << cartridge.get_chr_ram_size() << " " << cartridge.has_battery_backed_ram()
+                  << " # " << rom_path << ", " << (found ? "from the database" : (cartridge.is_nes2() ? "NES 2.0 header" : "iNES header"))
+                  << ", hashed in " << std::fixed << std::setprecision(1) << microseconds << " us" << std::defaultfloat << std::endl;
+    }
+
+    return result;
+}
+
+// Identifies ROMs by the CRC-32 of their contents and builds the database that corrects their headers
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "build") == 0) {
+        return build(argv[2], argv[3]);
+    }
+
+    if (argc < 3 || strcmp(argv[1], "identify") != 0) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<const char*> rom_paths;
+    const char* database_path = nullptr;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            database_path = argv[++i];
+        } else {
+            rom_paths.push_back(argv[i]);
+        }
+    }
+
+    return identify(rom_paths, database_path);
+}
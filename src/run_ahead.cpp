@@ -0,0 +1,58 @@
+#include "run_ahead.h"
+
+RunAhead::RunAhead(NES* nes_ptr, uint8_t frames_ahead) {
+    nes = nes_ptr;
+    state = new MachineState();
+    set_frames_ahead(frames_ahead);
+    reset_statistics();
+}
+
+RunAhead::~RunAhead() {
+    delete state;
+}
+
+void RunAhead::reset_statistics() {
+    frame_time = 0;
+    overhead_time = 0;
+    nr_of_frames = 0;
+}
+
+void RunAhead::run_frame() {
+    if (frames_ahead == 0) {
+        nes->run_frame();
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint8_t frame_skip = nes->get_frame_skip();
+
+    // The real frame is never shown, only the one furthest ahead is
+    nes->set_frame_skip(FRAME_SKIP_NEVER_RENDER);
+    nes->run_frame();
+
+    auto real_frame_done = std::chrono::steady_clock::now();
+
+    nes->save_state(*state);
+
+    // Frames that are run ahead are thrown away, so they mustn't be heard either
+    bool audio_enabled = nes->is_audio_enabled();
+    nes->set_audio_enabled(false);
+
+    for (uint8_t i = 0; i < frames_ahead; i++) {
+        if (i == frames_ahead - 1) {
+            nes->set_frame_skip(frame_skip);
+        }
+
+        nes->run_frame();
+    }
+
+    nes->load_state(*state);
+    nes->set_frame_skip(frame_skip);
+    nes->set_audio_enabled(audio_enabled);
+
+    auto done = std::chrono::steady_clock::now();
+
+    frame_time += std::chrono::duration<double>(real_frame_done - start).count();
+    overhead_time += std::chrono::duration<double>(done - real_frame_done).count();
+    nr_of_frames++;
+}
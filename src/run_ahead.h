@@ -0,0 +1,38 @@
+#ifndef RUN_AHEAD_H
+#define RUN_AHEAD_H
+
+#include <chrono>
+#include <stdint.h>
+
+#include "nes.h"
+
+#define MAX_FRAMES_AHEAD 4
+
+// Hides the input lag a game has built in. Every frame the machine is snapshotted, run a
+// few frames further with the current input to produce the frame that's shown, and restored.
+class RunAhead {
+private:
+    NES* nes;
+    MachineState* state;
+    uint8_t frames_ahead;
+
+    // Timing of the frames since the statistics were last reset, in seconds
+    double frame_time;    // The real frame
+    double overhead_time; // Snapshot, frames ahead and restore
+    uint32_t nr_of_frames;
+public:
+    RunAhead(NES* nes_ptr, uint8_t frames_ahead);
+    ~RunAhead();
+
+    void set_frames_ahead(uint8_t frames) { frames_ahead = frames < MAX_FRAMES_AHEAD ? frames : MAX_FRAMES_AHEAD; }
+    uint8_t get_frames_ahead() { return frames_ahead; }
+
+    void run_frame(); // Replaces NES::run_frame
+
+    // Average cost per frame, to tune the number of frames ahead for each game
+    double get_average_frame_time() { return nr_of_frames ? frame_time / nr_of_frames : 0; }
+    double get_average_overhead_time() { return nr_of_frames ? overhead_time / nr_of_frames : 0; }
+    void reset_statistics();
+};
+
+#endif
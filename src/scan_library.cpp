@@ -0,0 +1,222 @@
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cartridge.h"
+#include "crc32.h"
+#include "rom_database.h"
+#include "rom_index.h"
+#include "rom_batch.h"
+
+static const char* status_names[] = {"valid", "invalid header", "truncated", "unreadable"};
+
+static void fill_entry(RomIndexEntry& entry, const uint8_t* data, size_t size, const RomDatabase* database) {
+    Cartridge cartridge = Cartridge(data, size);
+
+    // The same checks NES::load_rom does
+    if (!cartridge.is_valid_header() || cartridge.get_nr_prg_rom_banks() == 0) {
+        entry.status = RomInvalidHeader;
+        return;
+    }
+
+    if (size < cartridge.get_rom_size()) {
+        entry.status = RomTruncated;
+        return;
+    }
+
+    size_t offset = INES_HEADER_SIZE + (cartridge.has_trainer() ? TRAINER_SIZE : 0);
+    entry.crc = crc32(data + offset, cartridge.get_rom_size() - offset);
+
+    RomDatabaseEntry database_entry;
+    if (database && database->find(entry.crc, database_entry)) {
+        cartridge.apply_database_entry(database_entry);
+        entry.from_database = true;
+    }
+
+    entry.status = RomValid;
+    entry.nes2 = cartridge.is_nes2();
+    entry.battery_backed_ram = cartridge.has_battery_backed_ram();
+    entry.mapper_number = cartridge.get_mapper_number();
+    entry.submapper = cartridge.get_submapper();
+    entry.mirroring = cartridge.has_four_screen_mirroring() ? FourScreenMirroring : (cartridge.get_mirror_type() ? VerticalMirroring : HorizontalMirroring);
+    entry.nr_prg_rom_banks = cartridge.get_nr_prg_rom_banks();
+    entry.nr_chr_rom_banks = cartridge.get_nr_chr_rom_banks();
+    entry.prg_ram_size = cartridge.get_prg_ram_size();
+    entry.prg_nvram_size = cartridge.get_prg_nvram_size();
+    entry.chr_ram_size = cartridge.get_chr_ram_size();
+}
+
+// Maps the file instead of reading it, the page cache is used as is and only the pages hashed are touched
+static RomIndexEntry scan_rom(const std::string& path, const RomDatabase* database, const RomIndex* previous, bool& reused) {
+    RomIndexEntry entry = {};
+    entry.path = path;
+    entry.status = RomUnreadable;
+    reused = false;
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return entry;
+    }
+
+    entry.file_size = info.st_size;
+    entry.modification_time = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+
+    // Unchanged files keep what was found last time
+    const RomIndexEntry* known = previous ? previous->find(path) : nullptr;
+    if (known && known->status != RomUnreadable && known->file_size == entry.file_size && known->modification_time == entry.modification_time) {
+        reused = true;
+        return *known;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return entry;
+    }
+
+    if (entry.file_size == 0) {
+        entry.status = RomInvalidHeader;
+        close(fd);
+        return entry;
+    }
+
+    void* data = mmap(nullptr, entry.file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return entry;
+    }
+
+    madvise(data, entry.file_size, MADV_SEQUENTIAL);
+    fill_entry(entry, (const uint8_t*) data, entry.file_size, database);
+    munmap(data, entry.file_size);
+
+    return entry;
+}
+
+static int list_index(const char* index_path) {
+    auto start = std::chrono::steady_clock::now();
+
+    RomIndex index;
+    if (!index.load(index_path)) {
+        return 1;
+    }
+
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const RomIndexEntry& entry : index.get_entries()) {
+        if (entry.status != RomValid) {
+            std::cout << std::setw(8) << std::setfill(' ') << status_names[entry.status] << " " << entry.path << std::endl;
+            continue;
+        }
+
+        std::cout << std::hex << std::setw(8) << std::setfill('0') << entry.crc << std::dec << " mapper " << entry.mapper_number
+                  << (entry.nes2 ? "." + std::to_string(entry.submapper) : "") << ", " << entry.nr_prg_rom_banks << "x16 KB PRG, "
+                  << entry.nr_chr_rom_banks << "x8 KB CHR" << (entry.from_database ? ", from the database" : "") << "  " << entry.path << std::endl;
+    }
+
+    std::cerr << "Loaded " << index.get_entries().size() << " entries in " << milliseconds << " ms" << std::endl;
+    return 0;
+}
+
+// Walks a ROM library and writes an index of every ROM in it, so frontends don't have to open them all
+int main(int argc, char **argv) {
+    // Usage: NES_scan <directory or rom>... --output index [--jobs n] [--db path] [--update]
+    //        NES_scan --list index
+    std::vector<std::string> inputs;
+    const char* index_path = nullptr;
+    const char* database_path = nullptr;
+    unsigned int nr_of_jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool update = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--list") == 0 && i + 1 < argc) {
+            return list_index(argv[i + 1]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            index_path = argv[++i];
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            nr_of_jobs = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            database_path = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0) {
+            // Only rescan files whose size or modification time changed since the existing index was written,
+            // not combined with --db
+            update = true;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty() || !index_path) {
+        std::cerr << "Usage: " << argv[0] << " <directory or rom>... --output index [--jobs n] [--db path] [--update]" << std::endl;
+        std::cerr << "       " << argv[0] << " --list index" << std::endl;
+        return 2;
+    }
+
+    RomDatabase database;
+    if (database_path && !database.load(database_path)) {
+        return 1;
+    }
+
+    // Entries from the database depend on its contents, so with one everything is rescanned
+    RomIndex previous;
+    bool has_previous = update && !database_path && std::filesystem::exists(index_path) && previous.load(index_path);
+
+    if (update && database_path) {
+        std::cerr << "Ignoring --update, the database may have changed since the index was written" << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Walking the tree is cheap next to opening every file, so it stays on one thread
+    std::vector<std::string> rom_paths = collect_roms(inputs);
+
+    std::vector<RomIndexEntry> entries(rom_paths.size());
+    std::atomic<size_t> reused_count(0);
+
+    // The cartridge logs every header it parses
+    NullBuffer null_buffer;
+    std::streambuf* stdout_buffer = std::cout.rdbuf(&null_buffer);
+
+    unsigned int nr_of_threads = parallel_for_each(rom_paths.size(), nr_of_jobs, [&](size_t rom) {
+        bool reused;
+        entries[rom] = scan_rom(rom_paths[rom], database_path ? &database : nullptr, has_previous ? &previous : nullptr, reused);
+        reused_count += reused;
+    });
+
+    std::cout.rdbuf(stdout_buffer);
+
+    size_t counts[4] = {};
+    for (const RomIndexEntry& entry : entries) {
+        counts[entry.status]++;
+    }
+
+    RomIndex index;
+    index.set_entries(std::move(entries));
+
+    if (!index.save(index_path)) {
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << "Indexed " << rom_paths.size() << " files in " << seconds << " s using " << nr_of_threads << " threads: ";
+    for (int status = RomValid; status <= RomUnreadable; status++) {
+        std::cerr << counts[status] << " " << status_names[status] << (status < RomUnreadable ? ", " : "");
+    }
+    std::cerr << (has_previous ? "; " + std::to_string(reused_count.load()) + " unchanged" : "") << std::endl;
+
+    return 0;
+}
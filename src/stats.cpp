@@ -0,0 +1,61 @@
+#include "stats.h"
+
+double get_timestamp_frequency() {
+    // Calibrated once against the steady clock
+    static double frequency = [] {
+        auto start_time = std::chrono::steady_clock::now();
+        uint64_t start_ticks = read_timestamp();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        uint64_t ticks = read_timestamp() - start_ticks;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        return ticks / seconds;
+    }();
+
+    return frequency;
+}
+
+FrameTimeHistory::FrameTimeHistory() {
+    count = 0;
+    next = 0;
+}
+
+FrameTimeHistory::~FrameTimeHistory() {}
+
+void FrameTimeHistory::add(double time) {
+    times[next] = time;
+    next = (next + 1) % FRAME_HISTORY_SIZE;
+
+    if (count < FRAME_HISTORY_SIZE) {
+        count++;
+    }
+}
+
+double FrameTimeHistory::get_percentile(double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+
+    double sorted[FRAME_HISTORY_SIZE];
+    std::copy(times, times + count, sorted);
+
+    uint32_t index = (uint32_t) (percentile * (count - 1));
+    std::nth_element(sorted, sorted + index, sorted + count);
+
+    return sorted[index];
+}
+
+double FrameTimeHistory::get_max() {
+    return count == 0 ? 0 : *std::max_element(times, times + count);
+}
+
+double FrameTimeHistory::get_average() {
+    double sum = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        sum += times[i];
+    }
+
+    return count == 0 ? 0 : sum / count;
+}
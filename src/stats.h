@@ -0,0 +1,64 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define FRAME_HISTORY_SIZE 600 // Frames the percentiles are taken over, 10 seconds
+
+// Cheapest clock there is; the TSC on x86, which runs at a constant rate on anything recent
+inline uint64_t read_timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double get_timestamp_frequency(); // Timestamp ticks per second, measured on first use
+inline double ticks_to_ms(uint64_t ticks) { return ticks * 1000.0 / get_timestamp_frequency(); }
+
+// Adds the time until it goes out of scope to a counter; does nothing without one
+class ScopedTimer {
+private:
+    uint64_t* total;
+    uint64_t start;
+public:
+    ScopedTimer(uint64_t* total_ptr) : total(total_ptr), start(total_ptr ? read_timestamp() : 0) {}
+    ~ScopedTimer() { if (total) *total += read_timestamp() - start; }
+};
+
+// Where the last frame went, in timestamp ticks
+struct FrameStats {
+    uint64_t instructions;
+    uint64_t cpu_cycles;
+
+    uint64_t frame_ticks; // All of NES::run_frame
+    uint64_t ppu_ticks;   // Scanline work, including composing the frame
+    uint64_t apu_ticks;   // Rendering audio at the end of the frame, plus stepping it with detailed timing
+    uint64_t cpu_ticks;   // Only with detailed timing, it costs two timestamps per instruction
+};
+
+// Running record of frame times to take percentiles from
+class FrameTimeHistory {
+private:
+    double times[FRAME_HISTORY_SIZE];
+    uint32_t count;
+    uint32_t next;
+public:
+    FrameTimeHistory();
+    ~FrameTimeHistory();
+
+    void add(double time);
+    double get_percentile(double percentile); // 0.5 for the median
+    double get_max();
+    double get_average();
+};
+
+#endif
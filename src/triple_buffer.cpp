@@ -0,0 +1,51 @@
+#include "triple_buffer.h"
+
+TripleBuffer::TripleBuffer(uint32_t size) {
+    buffer_size = size;
+
+    for (int i = 0; i < NR_OF_BUFFERS; i++) {
+        buffers[i] = new uint32_t[size];
+        memset(buffers[i], 0, size * sizeof(uint32_t));
+    }
+
+    back = 0;
+    latest = 1;
+    middle.store(1);
+    front = 2;
+    frame_count.store(0);
+}
+
+TripleBuffer::~TripleBuffer() {
+    for (int i = 0; i < NR_OF_BUFFERS; i++) {
+        delete[] buffers[i];
+    }
+}
+
+void TripleBuffer::publish() {
+    latest = back;
+
+    // Release makes the finished frame visible to the consumer that picks up the middle buffer
+    back = middle.exchange(back | BUFFER_FRESH, std::memory_order_acq_rel) & BUFFER_INDEX_MASK;
+
+    frame_count.fetch_add(1, std::memory_order_release);
+    frame_count.notify_one();
+}
+
+bool TripleBuffer::update_front() {
+    if (!(middle.load(std::memory_order_relaxed) & BUFFER_FRESH)) {
+        return false;
+    }
+
+    front = middle.exchange(front, std::memory_order_acq_rel) & BUFFER_INDEX_MASK;
+
+    return true;
+}
+
+void TripleBuffer::wait_for_frame(uint32_t last_frame_count) {
+    frame_count.wait(last_frame_count, std::memory_order_acquire);
+}
+
+void TripleBuffer::wake() {
+    frame_count.fetch_add(1, std::memory_order_release);
+    frame_count.notify_all();
+}
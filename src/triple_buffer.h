@@ -0,0 +1,47 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#define NR_OF_BUFFERS 3
+#define BUFFER_INDEX_MASK 0x03
+#define BUFFER_FRESH 0x04 // Set when the middle buffer holds a frame the consumer hasn't seen yet
+
+// Hands completed frames from the PPU to a presenter without either side ever waiting on the other.
+// The producer draws into the back buffer, the consumer reads the front buffer and the middle one
+// is swapped between them with a single atomic exchange.
+class TripleBuffer {
+private:
+    uint32_t* buffers[NR_OF_BUFFERS];
+    uint32_t buffer_size;
+
+    uint8_t back;  // Only touched by the producer
+    uint8_t latest; // Last buffer the producer published
+    uint8_t front; // Only touched by the consumer
+    std::atomic<uint8_t> middle;
+
+    // Counts published frames so a consumer can sleep until the next one
+    std::atomic<uint32_t> frame_count;
+public:
+    TripleBuffer(uint32_t size);
+    ~TripleBuffer();
+
+    // Producer side
+    uint32_t* get_back() { return buffers[back]; }
+    void publish(); // Make the back buffer the newest frame and continue in a free buffer
+    uint32_t* get_latest() { return buffers[latest]; } // Stays untouched until the producer publishes again
+
+    // Consumer side
+    bool update_front(); // Take the newest frame if there is one, returns false if nothing new was published
+    uint32_t* get_front() { return buffers[front]; }
+
+    uint32_t get_frame_count() { return frame_count.load(std::memory_order_acquire); }
+    void wait_for_frame(uint32_t last_frame_count); // Sleep until a frame after last_frame_count is published
+    void wake(); // Release a consumer blocked in wait_for_frame, used when shutting down
+
+    uint32_t get_size() { return buffer_size; }
+};
+
+#endif
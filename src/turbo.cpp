@@ -0,0 +1,77 @@
+#include "turbo.h"
+
+Turbo::Turbo() {
+    enabled = false;
+    multiplier_index = 0;
+    frame_skip = 0;
+    achieved_speed = 1;
+    reset_measurement();
+}
+
+Turbo::~Turbo() {}
+
+void Turbo::reset_measurement() {
+    window_start = std::chrono::steady_clock::now();
+    frame_start = window_start;
+    busy_time = 0;
+    frames = 0;
+}
+
+void Turbo::set_enabled(bool enable) {
+    if (enable == enabled) {
+        return;
+    }
+
+    enabled = enable;
+    achieved_speed = 1;
+
+    // There's no point composing more frames than the display shows, so start at one in every <multiplier>
+    uint8_t multiplier = get_multiplier();
+    frame_skip = enabled && multiplier != TURBO_UNCAPPED ? multiplier - 1 : 0;
+
+    reset_measurement();
+}
+
+void Turbo::next_multiplier() {
+    multiplier_index = (multiplier_index + 1) % (sizeof(multipliers) / sizeof(multipliers[0]));
+
+    if (enabled) {
+        // Restart the adjustment from the new multiplier's baseline
+        enabled = false;
+        set_enabled(true);
+    }
+}
+
+bool Turbo::end_frame() {
+    auto now = std::chrono::steady_clock::now();
+    busy_time += std::chrono::duration<double>(now - frame_start).count();
+    frames++;
+
+    double elapsed = std::chrono::duration<double>(now - window_start).count();
+    if (elapsed < TURBO_MEASURE_INTERVAL) {
+        return false;
+    }
+
+    achieved_speed = frames / (elapsed * NTSC_FRAME_RATE);
+
+    if (enabled) {
+        uint8_t multiplier = get_multiplier();
+
+        if (multiplier == TURBO_UNCAPPED) {
+            // Flat out; only render about as many frames as a 60 Hz display can show
+            uint8_t skip = (uint8_t) achieved_speed;
+            frame_skip = skip < TURBO_MAX_FRAME_SKIP ? skip : TURBO_MAX_FRAME_SKIP;
+        } else if (achieved_speed < multiplier * 0.97) {
+            // Falling short of the target, skip composing more frames
+            if (frame_skip < TURBO_MAX_FRAME_SKIP) {
+                frame_skip++;
+            }
+        } else if (busy_time < elapsed * 0.75 && frame_skip > multiplier - 1) {
+            // Plenty of time left waiting on the pacer, render more frames again
+            frame_skip--;
+        }
+    }
+
+    reset_measurement();
+    return true;
+}
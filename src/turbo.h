@@ -0,0 +1,49 @@
+#ifndef TURBO_H
+#define TURBO_H
+
+#include <chrono>
+#include <stdint.h>
+
+#include "frame_pacer.h"
+
+#define TURBO_UNCAPPED 0 // Multiplier that removes pacing altogether
+#define TURBO_MAX_FRAME_SKIP 15
+#define TURBO_MEASURE_INTERVAL 0.5 // Seconds between speed measurements and frame skip adjustments
+
+// Fast-forward: runs the core at a multiple of real time and picks a frame skip that lets it get there
+class Turbo {
+private:
+    constexpr static uint8_t multipliers[3] = {2, 4, TURBO_UNCAPPED};
+
+    bool enabled;
+    uint8_t multiplier_index;
+    uint8_t frame_skip;
+
+    // Current measurement window
+    std::chrono::steady_clock::time_point window_start;
+    std::chrono::steady_clock::time_point frame_start;
+    double busy_time; // Time spent running the core rather than waiting for the pacer
+    uint32_t frames;
+
+    double achieved_speed;
+
+    void reset_measurement();
+public:
+    Turbo();
+    ~Turbo();
+
+    void set_enabled(bool enable);
+    bool is_enabled() { return enabled; }
+    void next_multiplier(); // 2x -> 4x -> uncapped -> 2x
+
+    uint8_t get_multiplier() { return multipliers[multiplier_index]; }
+    double get_frame_rate() { return NTSC_FRAME_RATE * get_multiplier(); } // Only meaningful when capped
+    uint8_t get_frame_skip() { return frame_skip; }
+    double get_achieved_speed() { return achieved_speed; } // As a multiple of real time
+
+    // Bracket the core's work for each frame; end_frame returns true when a new measurement is in
+    void start_frame() { frame_start = std::chrono::steady_clock::now(); }
+    bool end_frame();
+};
+
+#endif
@@ -0,0 +1,422 @@
+#include "upscaler.h"
+#include "instrumentation.h"
+
+// Source pixel with the coordinates clamped to the image, edges repeat outwards
+static inline const uint32_t* clamped_row(const uint32_t* input, uint32_t width, uint32_t height, int32_t y) {
+    return input + (y < 0 ? 0 : (y >= (int32_t) height ? height - 1 : y)) * width;
+}
+
+static inline uint32_t clamped_x(uint32_t width, int32_t x) {
+    return x < 0 ? 0 : (x >= (int32_t) width ? width - 1 : x);
+}
+
+static void nearest_rows(const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height,
+                         uint8_t scale, uint32_t y_start, uint32_t y_end) {
+    uint32_t output_width = width * scale;
+
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const uint32_t* row = input + y * width;
+        uint32_t* out = output + y * scale * output_width;
+        uint32_t x = 0;
+
+#ifdef __SSE2__
+        // Four pixels in, scale registers of four out
+        for (; x + 4 <= width; x += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*) (row + x));
+            __m128i* destination = (__m128i*) (out + x * scale);
+
+            switch (scale) {
+                case 2: {
+                    _mm_storeu_si128(destination, _mm_unpacklo_epi32(pixels, pixels));
+                    _mm_storeu_si128(destination + 1, _mm_unpackhi_epi32(pixels, pixels));
+                    break;
+                }
+                case 3: {
+                    _mm_storeu_si128(destination, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 0, 0, 0)));
+                    _mm_storeu_si128(destination + 1, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 1, 1)));
+                    _mm_storeu_si128(destination + 2, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 2)));
+                    break;
+                }
+                case 4: {
+                    _mm_storeu_si128(destination, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 0, 0, 0)));
+                    _mm_storeu_si128(destination + 1, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(1, 1, 1, 1)));
+                    _mm_storeu_si128(destination + 2, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(2, 2, 2, 2)));
+                    _mm_storeu_si128(destination + 3, _mm_shuffle_epi32(pixels, _MM_SHUFFLE(3, 3, 3, 3)));
+                    break;
+                }
+                default: {
+                    _mm_storeu_si128(destination, pixels);
+                    break;
+                }
+            }
+        }
+#endif
+
+        for (; x < width; x++) {
+            for (uint8_t i = 0; i < scale; i++) {
+                out[x * scale + i] = row[x];
+            }
+        }
+
+        // The other output lines are the same
+        for (uint8_t i = 1; i < scale; i++) {
+            memcpy(out + i * output_width, out, output_width * sizeof(uint32_t));
+        }
+    }
+}
+
+// Scale2x (AdvanceMAME), grows edges along matching neighbours:
+//  A B C    E0 E1
+//  D E F    E2 E3
+//  G H I
+static void scale2x_rows(const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height,
+                         uint8_t scale, uint32_t y_start, uint32_t y_end) {
+    uint32_t output_width = width * 2;
+
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const uint32_t* above = clamped_row(input, width, height, y - 1);
+        const uint32_t* row = input + y * width;
+        const uint32_t* below = clamped_row(input, width, height, y + 1);
+        uint32_t* top = output + y * 2 * output_width;
+        uint32_t* bottom = top + output_width;
+        uint32_t x = 0;
+
+#ifdef __SSE2__
+        const __m128i ones = _mm_set1_epi32(-1);
+
+        for (; x + 4 <= width; x += 4) {
+            __m128i B = _mm_loadu_si128((const __m128i*) (above + x));
+            __m128i E = _mm_loadu_si128((const __m128i*) (row + x));
+            __m128i H = _mm_loadu_si128((const __m128i*) (below + x));
+
+            // Left and right neighbours, the edge pixels repeat at the ends of the line
+            __m128i D = x == 0 ? _mm_set_epi32(row[2], row[1], row[0], row[0])
+                               : _mm_loadu_si128((const __m128i*) (row + x - 1));
+            __m128i F = x + 4 == width ? _mm_set_epi32(row[x + 3], row[x + 3], row[x + 2], row[x + 1])
+                                       : _mm_loadu_si128((const __m128i*) (row + x + 1));
+
+            __m128i active = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F)), ones);
+
+            __m128i mask_0 = _mm_and_si128(active, _mm_cmpeq_epi32(D, B));
+            __m128i mask_1 = _mm_and_si128(active, _mm_cmpeq_epi32(B, F));
+            __m128i mask_2 = _mm_and_si128(active, _mm_cmpeq_epi32(D, H));
+            __m128i mask_3 = _mm_and_si128(active, _mm_cmpeq_epi32(H, F));
+
+            __m128i E0 = _mm_or_si128(_mm_and_si128(mask_0, D), _mm_andnot_si128(mask_0, E));
+            __m128i E1 = _mm_or_si128(_mm_and_si128(mask_1, F), _mm_andnot_si128(mask_1, E));
+            __m128i E2 = _mm_or_si128(_mm_and_si128(mask_2, D), _mm_andnot_si128(mask_2, E));
+            __m128i E3 = _mm_or_si128(_mm_and_si128(mask_3, F), _mm_andnot_si128(mask_3, E));
+
+            _mm_storeu_si128((__m128i*) (top + x * 2), _mm_unpacklo_epi32(E0, E1));
+            _mm_storeu_si128((__m128i*) (top + x * 2 + 4), _mm_unpackhi_epi32(E0, E1));
+            _mm_storeu_si128((__m128i*) (bottom + x * 2), _mm_unpacklo_epi32(E2, E3));
+            _mm_storeu_si128((__m128i*) (bottom + x * 2 + 4), _mm_unpackhi_epi32(E2, E3));
+        }
+#endif
+
+        for (; x < width; x++) {
+            uint32_t B = above[x];
+            uint32_t D = row[clamped_x(width, x - 1)];
+            uint32_t E = row[x];
+            uint32_t F = row[clamped_x(width, x + 1)];
+            uint32_t H = below[x];
+
+            bool active = B != H && D != F;
+            top[x * 2] = active && D == B ? D : E;
+            top[x * 2 + 1] = active && B == F ? F : E;
+            bottom[x * 2] = active && D == H ? D : E;
+            bottom[x * 2 + 1] = active && H == F ? F : E;
+        }
+    }
+}
+
+// Scale3x (AdvanceMAME):
+//  A B C    E0 E1 E2
+//  D E F    E3 E4 E5
+//  G H I    E6 E7 E8
+static void scale3x_rows(const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height,
+                         uint8_t scale, uint32_t y_start, uint32_t y_end) {
+    uint32_t output_width = width * 3;
+
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const uint32_t* above = clamped_row(input, width, height, y - 1);
+        const uint32_t* row = input + y * width;
+        const uint32_t* below = clamped_row(input, width, height, y + 1);
+        uint32_t* out = output + y * 3 * output_width;
+
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t left = clamped_x(width, x - 1);
+            uint32_t right = clamped_x(width, x + 1);
+
+            uint32_t A = above[left], B = above[x], C = above[right];
+            uint32_t D = row[left], E = row[x], F = row[right];
+            uint32_t G = below[left], H = below[x], I = below[right];
+
+            uint32_t* top = out + x * 3;
+            uint32_t* middle = top + output_width;
+            uint32_t* bottom = middle + output_width;
+
+            if (B != H && D != F) {
+                top[0] = D == B ? D : E;
+                top[1] = (D == B && E != C) || (B == F && E != A) ? B : E;
+                top[2] = B == F ? F : E;
+                middle[0] = (D == B && E != G) || (D == H && E != A) ? D : E;
+                middle[1] = E;
+                middle[2] = (B == F && E != I) || (H == F && E != C) ? F : E;
+                bottom[0] = D == H ? D : E;
+                bottom[1] = (D == H && E != I) || (H == F && E != G) ? H : E;
+                bottom[2] = H == F ? F : E;
+            } else {
+                top[0] = top[1] = top[2] = E;
+                middle[0] = middle[1] = middle[2] = E;
+                bottom[0] = bottom[1] = bottom[2] = E;
+            }
+        }
+    }
+}
+
+// Perceptual colour difference used by xBR, weighted towards luma
+static inline uint32_t yuv_distance(uint32_t a, uint32_t b) {
+    if (a == b) {
+        return 0;
+    }
+
+    int32_t r = (int32_t) ((a >> 16) & 0xFF) - (int32_t) ((b >> 16) & 0xFF);
+    int32_t g = (int32_t) ((a >> 8) & 0xFF) - (int32_t) ((b >> 8) & 0xFF);
+    int32_t b_ = (int32_t) (a & 0xFF) - (int32_t) (b & 0xFF);
+
+    int32_t y = abs(77 * r + 150 * g + 29 * b_);
+    int32_t u = abs(-43 * r - 85 * g + 128 * b_);
+    int32_t v = abs(128 * r - 107 * g - 21 * b_);
+
+    return (48 * y + 7 * u + 6 * v) >> 8;
+}
+
+static inline uint32_t blend_half(uint32_t a, uint32_t b) {
+    return (((a & 0xFEFEFE) >> 1) + ((b & 0xFEFEFE) >> 1)) | (a & 0xFF000000);
+}
+
+// The bottom right corner of E in xBR level 1; the other corners pass the neighbourhood mirrored
+//        A1 B1 C1
+//     A0  A  B  C C4
+//     D0  D  E  F F4
+//     G0  G  H  I I4
+//        G5 H5 I5
+static inline uint32_t xbr_corner(uint32_t E, uint32_t I, uint32_t H, uint32_t F, uint32_t G, uint32_t C,
+                                  uint32_t D, uint32_t B, uint32_t F4, uint32_t H5, uint32_t I4, uint32_t I5) {
+    if (E == H || E == F) {
+        return E;
+    }
+
+    // Weigh an edge along H-F against one along E-I
+    uint32_t edge_hf = yuv_distance(E, C) + yuv_distance(E, G) + yuv_distance(I, F4) + yuv_distance(I, H5) + 4 * yuv_distance(H, F);
+    uint32_t edge_ei = yuv_distance(H, D) + yuv_distance(H, I5) + yuv_distance(F, I4) + yuv_distance(F, B) + 4 * yuv_distance(E, I);
+
+    if (edge_hf >= edge_ei) {
+        return E;
+    }
+
+    return blend_half(E, yuv_distance(E, F) <= yuv_distance(E, H) ? F : H);
+}
+
+static void xbr2x_rows(const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height,
+                       uint8_t scale, uint32_t y_start, uint32_t y_end) {
+    uint32_t output_width = width * 2;
+
+    for (uint32_t y = y_start; y < y_end; y++) {
+        const uint32_t* row_0 = clamped_row(input, width, height, y - 2);
+        const uint32_t* row_1 = clamped_row(input, width, height, y - 1);
+        const uint32_t* row_2 = input + y * width;
+        const uint32_t* row_3 = clamped_row(input, width, height, y + 1);
+        const uint32_t* row_4 = clamped_row(input, width, height, y + 2);
+        uint32_t* top = output + y * 2 * output_width;
+        uint32_t* bottom = top + output_width;
+
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t x_1 = clamped_x(width, x - 1);
+            uint32_t x_3 = clamped_x(width, x + 1);
+
+            uint32_t A = row_1[x_1], B = row_1[x], C = row_1[x_3];
+            uint32_t D = row_2[x_1], E = row_2[x], F = row_2[x_3];
+            uint32_t G = row_3[x_1], H = row_3[x], I = row_3[x_3];
+
+            // Flat areas are most of a frame
+            if (A == E && B == E && C == E && D == E && F == E && G == E && H == E && I == E) {
+                top[x * 2] = top[x * 2 + 1] = E;
+                bottom[x * 2] = bottom[x * 2 + 1] = E;
+                continue;
+            }
+
+            uint32_t x_0 = clamped_x(width, x - 2);
+            uint32_t x_4 = clamped_x(width, x + 2);
+
+            uint32_t A1 = row_0[x_1], B1 = row_0[x], C1 = row_0[x_3];
+            uint32_t A0 = row_1[x_0], C4 = row_1[x_4];
+            uint32_t D0 = row_2[x_0], F4 = row_2[x_4];
+            uint32_t G0 = row_3[x_0], I4 = row_3[x_4];
+            uint32_t G5 = row_4[x_1], H5 = row_4[x], I5 = row_4[x_3];
+
+            top[x * 2] = xbr_corner(E, A, B, D, C, G, F, H, D0, B1, A0, A1);
+            top[x * 2 + 1] = xbr_corner(E, C, B, F, A, I, D, H, F4, B1, C4, C1);
+            bottom[x * 2] = xbr_corner(E, G, H, D, I, A, F, B, D0, H5, G0, G5);
+            bottom[x * 2 + 1] = xbr_corner(E, I, H, F, G, C, D, B, F4, H5, I4, I5);
+        }
+    }
+}
+
+Upscaler::Upscaler(uint8_t nr_of_threads) {
+    filter = Nearest;
+    scale = 2;
+
+    intermediate = new uint32_t[SCREEN_WIDTH * 2 * SCREEN_HEIGHT * 2];
+
+    nr_of_bands = nr_of_threads < 1 ? 1 : (nr_of_threads > MAX_UPSCALER_THREADS ? MAX_UPSCALER_THREADS : nr_of_threads);
+    running.store(true);
+    generation.store(0);
+    pending.store(0);
+
+    for (uint8_t band = 1; band < nr_of_bands; band++) {
+        workers.emplace_back(&Upscaler::worker, this, band);
+    }
+}
+
+Upscaler::~Upscaler() {
+    running.store(false);
+    generation.fetch_add(1, std::memory_order_release);
+    generation.notify_all();
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    delete[] intermediate;
+}
+
+bool Upscaler::set_filter(ScaleFilter filter, uint8_t scale) {
+    bool supported;
+
+    switch (filter) {
+        case Nearest: {
+            supported = scale >= 1 && scale <= MAX_UPSCALE;
+            break;
+        }
+        case ScaleNx: {
+            supported = scale >= 2 && scale <= MAX_UPSCALE;
+            break;
+        }
+        case XBR: {
+            supported = scale == 2 || scale == 4;
+            break;
+        }
+        default: {
+            supported = false;
+            break;
+        }
+    }
+
+    if (!supported) {
+        std::cout << "Unsupported upscale factor " << (int) scale << std::endl;
+        return false;
+    }
+
+    this->filter = filter;
+    this->scale = scale;
+    return true;
+}
+
+bool Upscaler::set_filter(const char* name) {
+    const char* names[3] = {"nearest", "scale", "xbr"};
+
+    for (uint8_t i = 0; i < 3; i++) {
+        size_t length = strlen(names[i]);
+
+        if (strncmp(name, names[i], length) == 0 && name[length] >= '1' && name[length] <= '9'
+                && strcmp(name + length + 1, "x") == 0) {
+            return set_filter((ScaleFilter) i, name[length] - '0');
+        }
+    }
+
+    std::cout << "Unknown upscale filter " << name << std::endl;
+    return false;
+}
+
+void Upscaler::worker(uint8_t band) {
+    ZONE_THREAD_NAME("upscaler");
+
+    uint32_t seen = 0;
+
+    while (true) {
+        generation.wait(seen, std::memory_order_acquire);
+        seen = generation.load(std::memory_order_acquire);
+
+        if (!running.load()) {
+            return;
+        }
+
+        run_band(band);
+
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            pending.notify_one();
+        }
+    }
+}
+
+void Upscaler::run_band(uint8_t band) {
+    ZONE("upscale band");
+
+    uint32_t y_start = pass_height * band / nr_of_bands;
+    uint32_t y_end = pass_height * (band + 1) / nr_of_bands;
+
+    pass_kernel(pass_input, pass_output, pass_width, pass_height, pass_scale, y_start, y_end);
+}
+
+void Upscaler::run_pass(ScaleKernel kernel, const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height, uint8_t scale) {
+    pass_kernel = kernel;
+    pass_input = input;
+    pass_output = output;
+    pass_width = width;
+    pass_height = height;
+    pass_scale = scale;
+
+    // Bands only read the input and write their own lines of the output, so they don't need to sync
+    pending.store(nr_of_bands - 1, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    generation.notify_all();
+
+    run_band(0);
+
+    uint32_t remaining;
+    while ((remaining = pending.load(std::memory_order_acquire)) != 0) {
+        pending.wait(remaining, std::memory_order_acquire);
+    }
+}
+
+void Upscaler::upscale(const uint32_t* input, uint32_t* output) {
+    switch (filter) {
+        case Nearest: {
+            run_pass(nearest_rows, input, output, SCREEN_WIDTH, SCREEN_HEIGHT, scale);
+            break;
+        }
+        case ScaleNx: {
+            if (scale == 3) {
+                run_pass(scale3x_rows, input, output, SCREEN_WIDTH, SCREEN_HEIGHT, 3);
+            } else if (scale == 4) {
+                // Scale4x is Scale2x twice
+                run_pass(scale2x_rows, input, intermediate, SCREEN_WIDTH, SCREEN_HEIGHT, 2);
+                run_pass(scale2x_rows, intermediate, output, SCREEN_WIDTH * 2, SCREEN_HEIGHT * 2, 2);
+            } else {
+                run_pass(scale2x_rows, input, output, SCREEN_WIDTH, SCREEN_HEIGHT, 2);
+            }
+            break;
+        }
+        case XBR: {
+            if (scale == 4) {
+                run_pass(xbr2x_rows, input, intermediate, SCREEN_WIDTH, SCREEN_HEIGHT, 2);
+                run_pass(xbr2x_rows, intermediate, output, SCREEN_WIDTH * 2, SCREEN_HEIGHT * 2, 2);
+            } else {
+                run_pass(xbr2x_rows, input, output, SCREEN_WIDTH, SCREEN_HEIGHT, 2);
+            }
+            break;
+        }
+    }
+}
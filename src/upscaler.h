@@ -0,0 +1,68 @@
+#ifndef UPSCALER_H
+#define UPSCALER_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ppu.h"
+
+#define MAX_UPSCALE 4
+#define MAX_UPSCALER_THREADS 8
+
+enum ScaleFilter { Nearest, ScaleNx, XBR };
+
+// Scales one pass of rows [y_start, y_end) of the input
+typedef void (*ScaleKernel)(const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height,
+                            uint8_t scale, uint32_t y_start, uint32_t y_end);
+
+// Pixel art upscaling of finished frames on the CPU, for machines without a GPU to do it.
+// Each pass is split into horizontal bands that are scaled in parallel on a small pool of threads.
+class Upscaler {
+private:
+    ScaleFilter filter;
+    uint8_t scale;
+
+    uint32_t* intermediate; // Output of the first 2x pass for the 4x filters
+
+    // The pass that's being run, read by the workers once generation changes
+    ScaleKernel pass_kernel;
+    const uint32_t* pass_input;
+    uint32_t* pass_output;
+    uint32_t pass_width;
+    uint32_t pass_height;
+    uint8_t pass_scale;
+
+    uint8_t nr_of_bands; // The calling thread scales a band too
+    std::vector<std::thread> workers;
+    std::atomic<bool> running;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> pending;
+
+    void worker(uint8_t band);
+    void run_band(uint8_t band);
+    void run_pass(ScaleKernel kernel, const uint32_t* input, uint32_t* output, uint32_t width, uint32_t height, uint8_t scale);
+public:
+    Upscaler(uint8_t nr_of_threads);
+    ~Upscaler();
+
+    bool set_filter(ScaleFilter filter, uint8_t scale);
+    bool set_filter(const char* name); // nearest2x-4x, scale2x-4x, xbr2x or xbr4x
+
+    uint8_t get_scale() { return scale; }
+    uint32_t get_output_width() { return SCREEN_WIDTH * scale; }
+    uint32_t get_output_height() { return SCREEN_HEIGHT * scale; }
+
+    // output must hold get_output_width() * get_output_height() pixels
+    void upscale(const uint32_t* input, uint32_t* output);
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include "video_capture.h"
+
+VideoCapture::VideoCapture(CaptureFormat format, CapturePolicy policy) {
+    this->format = format;
+    this->policy = policy;
+
+    fd = -1;
+    owns_fd = false;
+
+    for (int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+        slots[i] = new uint32_t[SCREEN_WIDTH * SCREEN_HEIGHT];
+    }
+
+    head.store(0);
+    tail.store(0);
+    signal.store(0);
+
+    if (format == Y4M) {
+        output_size = SCREEN_WIDTH * SCREEN_HEIGHT * 3 / 2;
+    } else {
+        output_size = SCREEN_WIDTH * SCREEN_HEIGHT * 3;
+    }
+
+    output = new uint8_t[output_size];
+
+    running.store(false);
+    failed.store(false);
+    frames_written.store(0);
+    frames_dropped.store(0);
+}
+
+VideoCapture::~VideoCapture() {
+    close();
+
+    for (int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+        delete[] slots[i];
+    }
+
+    delete[] output;
+}
+
+bool VideoCapture::open(const char* path) {
+    if (strcmp(path, "-") == 0) {
+        return open_fd(STDOUT_FILENO);
+    }
+
+    // A named pipe blocks here until the encoder opens its end
+    int file_descriptor = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (file_descriptor < 0) {
+        std::cout << "Failed to open capture output " << path << std::endl;
+        return false;
+    }
+
+    if (!open_fd(file_descriptor)) {
+        ::close(file_descriptor);
+        return false;
+    }
+
+    owns_fd = true;
+
+    return true;
+}
+
+bool VideoCapture::open_fd(int file_descriptor) {
+    fd = file_descriptor;
+    owns_fd = false;
+
+    if (format == Y4M) {
+        std::string header = "YUV4MPEG2 W" + std::to_string(SCREEN_WIDTH) + " H" + std::to_string(SCREEN_HEIGHT)
+                + " F" Y4M_FRAME_RATE " Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+
+        if (!write_all((const uint8_t*) header.data(), header.size())) {
+            return false;
+        }
+    }
+
+    running.store(true);
+    worker = std::thread(&VideoCapture::run, this);
+
+    return true;
+}
+
+void VideoCapture::close() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+    worker.join();
+
+    if (owns_fd) {
+        ::close(fd);
+    }
+
+    fd = -1;
+}
+
+void VideoCapture::submit(const uint32_t* frame) {
+    if (!running.load(std::memory_order_relaxed) || failed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    uint32_t current_head = head.load(std::memory_order_relaxed);
+    uint32_t current_tail = tail.load(std::memory_order_acquire);
+
+    while (current_head - current_tail == CAPTURE_QUEUE_SIZE) {
+        if (policy == DropFrames) {
+            frames_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // Backpressure: wait for the worker to free a slot
+        tail.wait(current_tail, std::memory_order_acquire);
+        current_tail = tail.load(std::memory_order_acquire);
+    }
+
+    memcpy(slots[current_head % CAPTURE_QUEUE_SIZE], frame, SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+    head.store(current_head + 1, std::memory_order_release);
+
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+}
+
+void VideoCapture::run() {
+    while (true) {
+        // Read the signal first, so a submit or close after the checks below still wakes us
+        uint32_t current_signal = signal.load(std::memory_order_acquire);
+        uint32_t current_tail = tail.load(std::memory_order_relaxed);
+
+        if (current_tail == head.load(std::memory_order_acquire)) {
+            if (!running.load()) {
+                break;
+            }
+
+            signal.wait(current_signal, std::memory_order_acquire);
+            continue;
+        }
+
+        const uint32_t* frame = slots[current_tail % CAPTURE_QUEUE_SIZE];
+        bool written;
+
+        if (format == Y4M) {
+            convert_to_yuv420(frame, output);
+            written = write_all((const uint8_t*) "FRAME\n", 6) && write_all(output, output_size);
+        } else {
+            convert_to_rgb(frame, output);
+            written = write_all(output, output_size);
+        }
+
+        if (written) {
+            frames_written.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // The reader went away; stop capturing but never hold up the producer
+            failed.store(true);
+        }
+
+        tail.store(current_tail + 1, std::memory_order_release);
+        tail.notify_one();
+    }
+}
+
+bool VideoCapture::write_all(const uint8_t* data, uint32_t size) {
+    while (size > 0) {
+        ssize_t result = write(fd, data, size);
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += result;
+        size -= result;
+    }
+
+    return true;
+}
+
+void VideoCapture::convert_to_yuv420(const uint32_t* frame, uint8_t* out) {
+    uint8_t* y_plane = out;
+    uint8_t* u_plane = out + SCREEN_WIDTH * SCREEN_HEIGHT;
+    uint8_t* v_plane = u_plane + SCREEN_WIDTH * SCREEN_HEIGHT / 4;
+
+    // Every iteration handles 2 lines, which share one line of chroma
+    for (int y = 0; y < SCREEN_HEIGHT; y += 2) {
+        const uint32_t* row_0 = frame + y * SCREEN_WIDTH;
+        const uint32_t* row_1 = row_0 + SCREEN_WIDTH;
+        uint8_t* y_row_0 = y_plane + y * SCREEN_WIDTH;
+        uint8_t* y_row_1 = y_row_0 + SCREEN_WIDTH;
+        uint8_t* u_row = u_plane + (y / 2) * (SCREEN_WIDTH / 2);
+        uint8_t* v_row = v_plane + (y / 2) * (SCREEN_WIDTH / 2);
+
+#ifdef __SSE2__
+        const __m128i channel_mask = _mm_set1_epi32(0xFF);
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i zero = _mm_setzero_si128();
+
+        // 8 pixels of both lines at a time, giving 16 luma and 4 chroma samples
+        for (int x = 0; x < SCREEN_WIDTH; x += 8) {
+            __m128i r[2], g[2], b[2];
+
+            for (int line = 0; line < 2; line++) {
+                const uint32_t* row = line == 0 ? row_0 : row_1;
+                __m128i low = _mm_loadu_si128((const __m128i*) (row + x));
+                __m128i high = _mm_loadu_si128((const __m128i*) (row + x + 4));
+
+                // Separate the channels into 8 16-bit lanes
+                b[line] = _mm_packs_epi32(_mm_and_si128(low, channel_mask), _mm_and_si128(high, channel_mask));
+                g[line] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), channel_mask), _mm_and_si128(_mm_srli_epi32(high, 8), channel_mask));
+                r[line] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), channel_mask), _mm_and_si128(_mm_srli_epi32(high, 16), channel_mask));
+
+                // Y = ((66 R + 129 G + 25 B + 128) >> 8) + 16; the sum fits in an unsigned 16-bit lane
+                __m128i luma = _mm_add_epi16(_mm_mullo_epi16(r[line], _mm_set1_epi16(66)), _mm_mullo_epi16(g[line], _mm_set1_epi16(129)));
+                luma = _mm_add_epi16(luma, _mm_mullo_epi16(b[line], _mm_set1_epi16(25)));
+                luma = _mm_add_epi16(_mm_srli_epi16(_mm_add_epi16(luma, _mm_set1_epi16(128)), 8), _mm_set1_epi16(16));
+
+                _mm_storel_epi64((__m128i*) ((line == 0 ? y_row_0 : y_row_1) + x), _mm_packus_epi16(luma, zero));
+            }
+
+            // Average every 2x2 block: add the lines, then the horizontal pairs
+            __m128i r_average = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(r[0], r[1]), ones), _mm_set1_epi32(2)), 2);
+            __m128i g_average = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(g[0], g[1]), ones), _mm_set1_epi32(2)), 2);
+            __m128i b_average = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_add_epi16(b[0], b[1]), ones), _mm_set1_epi32(2)), 2);
+
+            __m128i r_16 = _mm_packs_epi32(r_average, r_average);
+            __m128i g_16 = _mm_packs_epi32(g_average, g_average);
+            __m128i b_16 = _mm_packs_epi32(b_average, b_average);
+
+            // U = ((-38 R - 74 G + 112 B + 128) >> 8) + 128, V = ((112 R - 94 G - 18 B + 128) >> 8) + 128
+            __m128i u = _mm_add_epi16(_mm_mullo_epi16(r_16, _mm_set1_epi16(-38)), _mm_mullo_epi16(g_16, _mm_set1_epi16(-74)));
+            u = _mm_add_epi16(u, _mm_mullo_epi16(b_16, _mm_set1_epi16(112)));
+            u = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(u, _mm_set1_epi16(128)), 8), _mm_set1_epi16(128));
+
+            __m128i v = _mm_add_epi16(_mm_mullo_epi16(r_16, _mm_set1_epi16(112)), _mm_mullo_epi16(g_16, _mm_set1_epi16(-94)));
+            v = _mm_add_epi16(v, _mm_mullo_epi16(b_16, _mm_set1_epi16(-18)));
+            v = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(v, _mm_set1_epi16(128)), 8), _mm_set1_epi16(128));
+
+            uint32_t u_samples = _mm_cvtsi128_si32(_mm_packus_epi16(u, zero));
+            uint32_t v_samples = _mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+            memcpy(u_row + x / 2, &u_samples, 4);
+            memcpy(v_row + x / 2, &v_samples, 4);
+        }
+#else
+        for (int x = 0; x < SCREEN_WIDTH; x += 2) {
+            int r_sum = 0, g_sum = 0, b_sum = 0;
+
+            for (int line = 0; line < 2; line++) {
+                const uint32_t* row = line == 0 ? row_0 : row_1;
+                uint8_t* y_row = line == 0 ? y_row_0 : y_row_1;
+
+                for (int i = 0; i < 2; i++) {
+                    int r = (row[x + i] >> 16) & 0xFF;
+                    int g = (row[x + i] >> 8) & 0xFF;
+                    int b = row[x + i] & 0xFF;
+
+                    y_row[x + i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+
+                    r_sum += r;
+                    g_sum += g;
+                    b_sum += b;
+                }
+            }
+
+            int r = (r_sum + 2) >> 2;
+            int g = (g_sum + 2) >> 2;
+            int b = (b_sum + 2) >> 2;
+
+            u_row[x / 2] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            v_row[x / 2] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+#endif
+    }
+}
+
+void VideoCapture::convert_to_rgb(const uint32_t* frame, uint8_t* out) {
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        out[i * 3] = (frame[i] >> 16) & 0xFF;
+        out[i * 3 + 1] = (frame[i] >> 8) & 0xFF;
+        out[i * 3 + 2] = frame[i] & 0xFF;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef VIDEO_CAPTURE_H
+#define VIDEO_CAPTURE_H
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ppu.h"
+
+#define CAPTURE_QUEUE_SIZE 8 // Frames that can be waiting for the worker
+#define Y4M_FRAME_RATE "39375000:655171" // 60.0988 Hz as an exact fraction
+
+enum CaptureFormat { Y4M, RawRGB };
+
+// What to do with a frame when the worker is CAPTURE_QUEUE_SIZE frames behind
+enum CapturePolicy { DropFrames, Backpressure };
+
+// Streams completed frames to a file, pipe or named pipe. Conversion and writing happen on a
+// worker thread, the emulation thread only copies the frame into a bounded queue.
+class VideoCapture {
+private:
+    CaptureFormat format;
+    CapturePolicy policy;
+
+    int fd;
+    bool owns_fd;
+
+    // Single producer, single consumer ring of frame copies
+    uint32_t* slots[CAPTURE_QUEUE_SIZE];
+    std::atomic<uint32_t> head; // Frames submitted
+    std::atomic<uint32_t> tail; // Frames converted and written
+
+    // Bumped on every submit and on close, the worker sleeps on it
+    std::atomic<uint32_t> signal;
+
+    uint8_t* output;
+    uint32_t output_size;
+
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<bool> failed;
+
+    std::atomic<uint64_t> frames_written;
+    std::atomic<uint64_t> frames_dropped;
+
+    void run();
+    bool write_all(const uint8_t* data, uint32_t size);
+
+    // ARGB to planar YUV 4:2:0, BT.601 limited range
+    void convert_to_yuv420(const uint32_t* frame, uint8_t* out);
+    void convert_to_rgb(const uint32_t* frame, uint8_t* out);
+public:
+    VideoCapture(CaptureFormat format, CapturePolicy policy);
+    ~VideoCapture();
+
+    bool open(const char* path); // "-" writes to stdout
+    bool open_fd(int file_descriptor);
+    void close(); // Writes out every queued frame before returning
+
+    void submit(const uint32_t* frame);
+
+    uint64_t get_frames_written() { return frames_written.load(); }
+    uint64_t get_frames_dropped() { return frames_dropped.load(); }
+    bool has_failed() { return failed.load(); }
+};
+
+#endif
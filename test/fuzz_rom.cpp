@@ -0,0 +1,69 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+
+#include "../src/nes.h"
+
+#define FUZZ_MAX_INSTRUCTIONS 10000 // Enough to get past typical init code, few enough for thousands of runs per second
+
+static NES* nes = nullptr;
+static MachineState* power_on = nullptr;
+
+static void initialize() {
+    // The core's logging would otherwise dominate the time per input, a failed stream skips all formatting
+    std::cout.setstate(std::ios::failbit);
+
+    nes = new NES();
+    nes->set_audio_enabled(false);
+
+    power_on = new MachineState();
+    nes->save_state(*power_on);
+}
+
+// Parses arbitrary bytes as a ROM and, if they're accepted, runs a bounded number of instructions from the reset vector
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (!nes) {
+        initialize();
+    }
+
+    // Rewinding to the power-on snapshot is a handful of memcpys, far cheaper than a new NES
+    nes->load_state(*power_on);
+
+    if (!nes->load_rom(data, size)) {
+        return 0;
+    }
+
+    nes->reset();
+    for (int i = 0; i < FUZZ_MAX_INSTRUCTIONS; i++) {
+        nes->execute_next_instruction();
+    }
+
+    return 0;
+}
+
+#ifndef NES_LIBFUZZER
+// Without libFuzzer this replays a corpus or crash reproducers, e.g. under a debugger or sanitizers
+int main(int argc, char **argv) {
+    // Usage: fuzz_rom <input>...
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <input>..." << std::endl;
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 1; i < argc; i++) {
+        std::ifstream input(argv[i], std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Ran " << argc - 1 << " inputs in " << seconds << " s (" << (argc - 1) / seconds << " execs/s)" << std::endl;
+
+    return 0;
+}
+#endif
@@ -0,0 +1,273 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "../src/nes.h"
+#include "../src/movie.h"
+#include "../src/hash.h"
+#include "../src/rom_batch.h"
+
+#define DEFAULT_INTERVAL 60 // Hash every second of emulated time
+#define DEFAULT_FRAMES 600 // For ROMs without a movie
+
+enum GoldenStatus { Matched, Mismatched, Recorded, GoldenError };
+
+// Hashes taken at one checkpoint
+struct Checkpoint {
+    uint64_t frame;
+    uint64_t frame_hash;
+    uint64_t ram_hash;
+};
+
+struct GoldenResult {
+    std::string rom_path;
+    GoldenStatus status;
+    std::string message;
+    double seconds;
+};
+
+static const char* status_names[] = {"matched", "mismatched", "recorded", "error"};
+
+static std::string to_hex(uint64_t value) {
+    std::stringstream text;
+    text << std::hex << std::setw(16) << std::setfill('0') << value;
+    return text.str();
+}
+
+static bool read_golden(const std::string& path, uint64_t& interval, uint64_t& frames, std::vector<Checkpoint>& checkpoints) {
+    std::ifstream input(path);
+    if (!input) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::stringstream fields(line);
+        std::string key;
+        fields >> key;
+
+        if (key == "interval") {
+            fields >> interval;
+        } else if (key == "frames") {
+            fields >> frames;
+        } else {
+            Checkpoint checkpoint;
+            checkpoint.frame = strtoull(key.c_str(), nullptr, 10);
+            fields >> std::hex >> checkpoint.frame_hash >> checkpoint.ram_hash;
+            checkpoints.push_back(checkpoint);
+        }
+    }
+
+    return interval > 0;
+}
+
+static bool write_golden(const std::string& path, const std::string& rom_path, uint64_t interval, uint64_t frames, const std::vector<Checkpoint>& checkpoints) {
+    std::ofstream output(path);
+    if (!output) {
+        return false;
+    }
+
+    output << "# Golden hashes of " << std::filesystem::path(rom_path).filename().string() << ": frame, framebuffer hash, CPU RAM hash\n";
+    output << "interval " << interval << "\nframes " << frames << "\n";
+
+    for (const Checkpoint& checkpoint : checkpoints) {
+        output << checkpoint.frame << " " << to_hex(checkpoint.frame_hash) << " " << to_hex(checkpoint.ram_hash) << "\n";
+    }
+
+    return true;
+}
+
+// Replays <rom>.nmv if there is one and hashes every interval-th frame, then records or checks against <rom>.golden
+static GoldenResult run_rom(const std::string& rom_path, bool record, uint64_t interval, uint64_t frames) {
+    GoldenResult result = {rom_path, GoldenError, "", 0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::string golden_path = rom_path + ".golden";
+    std::vector<Checkpoint> expected;
+
+    if (!record && !read_golden(golden_path, interval, frames, expected)) {
+        result.message = "No golden file, create one with --record";
+        return result;
+    }
+
+    NES* nes = new NES();
+
+    if (!nes->load_rom(rom_path.c_str())) {
+        result.message = "Could not load the ROM";
+        delete nes;
+        return result;
+    }
+
+    nes->set_audio_enabled(false);
+
+    Movie* movie = nullptr;
+    std::string movie_path = rom_path + ".nmv";
+
+    if (std::filesystem::exists(movie_path)) {
+        movie = new Movie();
+
+        if (!movie->load(movie_path.c_str())) {
+            result.message = "Could not load " + movie_path;
+            delete movie;
+            delete nes;
+            return result;
+        }
+
+        if (record) {
+            frames = movie->get_nr_of_frames();
+        }
+    }
+
+    std::vector<Checkpoint> checkpoints;
+    result.status = record ? Recorded : Matched;
+
+    for (uint64_t frame = 1; frame <= frames; frame++) {
+        if (movie && !movie->is_finished()) {
+            nes->set_controller_state(movie->next_frame());
+        }
+
+        nes->run_frame();
+
+        if (frame % interval != 0) {
+            continue;
+        }
+
+        // Only checkpoints are hashed, so the cost is a fraction of a frame every interval
+        TripleBuffer* frame_buffer = nes->get_frame_buffer();
+        Checkpoint checkpoint = {
+            frame,
+            hash64(frame_buffer->get_latest(), frame_buffer->get_size() * sizeof(uint32_t)),
+            hash64(nes->get_ram(), CPU_RAM_SIZE)
+        };
+
+        if (record) {
+            checkpoints.push_back(checkpoint);
+            continue;
+        }
+
+        size_t index = checkpoints.size();
+        checkpoints.push_back(checkpoint);
+
+        if (index >= expected.size() || expected[index].frame != frame) {
+            result.status = Mismatched;
+            result.message = "The golden file has no checkpoint for frame " + std::to_string(frame);
+            break;
+        }
+
+        if (expected[index].frame_hash != checkpoint.frame_hash || expected[index].ram_hash != checkpoint.ram_hash) {
+            result.status = Mismatched;
+            result.message = "Frame " + std::to_string(frame) + ": ";
+
+            if (expected[index].frame_hash != checkpoint.frame_hash) {
+                result.message += "framebuffer " + to_hex(checkpoint.frame_hash) + ", expected " + to_hex(expected[index].frame_hash) + "; ";
+            }
+            if (expected[index].ram_hash != checkpoint.ram_hash) {
+                result.message += "RAM " + to_hex(checkpoint.ram_hash) + ", expected " + to_hex(expected[index].ram_hash) + "; ";
+            }
+
+            result.message.resize(result.message.size() - 2);
+            break;
+        }
+    }
+
+    if (record && !write_golden(golden_path, rom_path, interval, frames, checkpoints)) {
+        result.status = GoldenError;
+        result.message = "Could not write " + golden_path;
+    } else if (record) {
+        result.message = std::to_string(checkpoints.size()) + " checkpoints over " + std::to_string(frames) + " frames";
+    } else if (result.status == Matched && checkpoints.size() != expected.size()) {
+        result.status = Mismatched;
+        result.message = "Only " + std::to_string(checkpoints.size()) + " of " + std::to_string(expected.size()) + " checkpoints were reached";
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    delete movie;
+    delete nes;
+    return result;
+}
+
+// Regression suite: replays movies on a set of ROMs and compares hashes of frames and RAM against golden files
+int main(int argc, char **argv) {
+    // Usage: golden_frames <directory or rom>... [--record] [--interval n] [--frames n] [--jobs n] [--verbose]
+    std::vector<std::string> inputs;
+    bool record = false;
+    uint64_t interval = DEFAULT_INTERVAL;
+    uint64_t frames = DEFAULT_FRAMES;
+    unsigned int nr_of_jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0) {
+            record = true;
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = std::max(1ULL, strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            nr_of_jobs = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cout << "Usage: " << argv[0] << " <directory or rom>... [--record] [--interval n] [--frames n] [--jobs n] [--verbose]" << std::endl;
+        return 2;
+    }
+
+    std::vector<std::string> rom_paths = collect_roms(inputs);
+
+    if (rom_paths.empty()) {
+        std::cout << "No ROMs found" << std::endl;
+        return 2;
+    }
+
+    std::vector<GoldenResult> results(rom_paths.size());
+
+    NullBuffer null_buffer;
+    std::streambuf* stdout_buffer = std::cout.rdbuf();
+    if (!verbose) {
+        std::cout.rdbuf(&null_buffer);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    unsigned int nr_of_threads = parallel_for_each(rom_paths.size(), nr_of_jobs, [&](size_t rom) {
+        results[rom] = run_rom(rom_paths[rom], record, interval, frames);
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(stdout_buffer);
+
+    size_t good = 0;
+    for (const GoldenResult& result : results) {
+        bool is_good = result.status == Matched || result.status == Recorded;
+        good += is_good;
+
+        if (!is_good || record) {
+            std::cout << status_names[result.status] << ": " << result.rom_path << "\n    " << result.message << std::endl;
+        }
+    }
+
+    std::cout << good << "/" << results.size() << " ROMs " << (record ? "recorded" : "matched their golden hashes")
+              << " in " << seconds << " s using " << nr_of_threads << " threads" << std::endl;
+
+    return good == results.size() ? 0 : 1;
+}
@@ -1,28 +1,369 @@
 #ifndef INES_HEADER_TEST
 #define INES_HEADER_TEST
 #define BOOST_TEST_DYN_LINK
-#define BOOST_TEST_MODULE
+#define BOOST_TEST_MODULE ines_header_test
 
 #include <boost/test/unit_test.hpp>
 #include <fstream>
+#include <random>
 
+#include "../src/cartridge.h"
 #include "../src/nes.h"
+#include "../src/bus.h"
+#include "../src/crc32.h"
+#include "../src/rom_database.h"
+#include "../src/rom_index.h"
+#include "../src/disassembler.h"
+#include "../src/code_data_logger.h"
+
+// The header of The Legend of Zelda, so the test doesn't need the ROM itself
+static const uint8_t zelda_header[16] = {'N', 'E', 'S', 0x1A, 8, 0, 0x28, 0x00, 1, 0, 0, 0, 0, 0, 0, 0};
 
 BOOST_AUTO_TEST_CASE(simple_test) {
-    NES nes = NES();
-    std::ifstream input("../roms/LegendOfZelda.nes", std::ios::binary);
-    iNES_header header = nes.parse_header(input);
-
-    BOOST_CHECK_EQUAL(header.is_valid_header, true);
-    BOOST_CHECK_EQUAL(header.nr_prg_rom_banks , 8);
-    BOOST_CHECK_EQUAL(header.nr_chr_rom_banks, 0);
-    BOOST_CHECK_EQUAL(header.four_screen_mirroring, true);
-    BOOST_CHECK_EQUAL(header.has_battery_backed_ram, false);
-    BOOST_CHECK_EQUAL(header.has_trainer, false);
-    BOOST_CHECK_EQUAL(header.mapper_number, 2);
-    BOOST_CHECK_EQUAL(header.nr_ram_banks, 1);
+    {
+        std::ofstream output("ines_header_test.nes", std::ios::binary);
+        output.write((const char*) zelda_header, sizeof(zelda_header));
+    }
+
+    std::ifstream input("ines_header_test.nes", std::ios::binary);
+    Cartridge cartridge = Cartridge(input);
+
+    BOOST_CHECK_EQUAL(cartridge.is_valid_header(), true);
+    BOOST_CHECK_EQUAL(cartridge.get_nr_prg_rom_banks(), 8);
+    BOOST_CHECK_EQUAL(cartridge.get_nr_chr_rom_banks(), 0);
+    BOOST_CHECK_EQUAL(cartridge.has_four_screen_mirroring(), true);
+    BOOST_CHECK_EQUAL(cartridge.has_battery_backed_ram(), false);
+    BOOST_CHECK_EQUAL(cartridge.has_trainer(), false);
+    BOOST_CHECK_EQUAL(cartridge.get_mapper_number(), 2);
+    BOOST_CHECK_EQUAL(cartridge.get_nr_ram_banks(), 1);
 
     input.close();
 }
 
-#endif
\ No newline at end of file
+BOOST_AUTO_TEST_CASE(invalid_header_test) {
+    uint8_t header[16];
+    memcpy(header, zelda_header, sizeof(header));
+    header[3] = 0x00;
+
+    // Rejected without exiting
+    Cartridge cartridge = Cartridge(header, sizeof(header));
+    BOOST_CHECK_EQUAL(cartridge.is_valid_header(), false);
+    BOOST_CHECK(!cartridge.get_error().empty());
+
+    Cartridge too_short = Cartridge(zelda_header, 8);
+    BOOST_CHECK_EQUAL(too_short.is_valid_header(), false);
+}
+
+BOOST_AUTO_TEST_CASE(truncated_rom_test) {
+    // The header promises 8 PRG-ROM banks, but the image only holds 3 of them
+    std::vector<uint8_t> rom(zelda_header, zelda_header + sizeof(zelda_header));
+    rom.resize(rom.size() + 3 * PRG_ROM_BANK_SIZE);
+
+    NES nes = NES();
+    BOOST_CHECK_EQUAL(nes.load_rom(rom.data(), rom.size()), false);
+
+    rom.resize(16 + 8 * PRG_ROM_BANK_SIZE);
+    BOOST_CHECK_EQUAL(nes.load_rom(rom.data(), rom.size()), true);
+}
+
+BOOST_AUTO_TEST_CASE(trainer_and_unused_bytes_test) {
+    uint8_t header[16];
+    memcpy(header, zelda_header, sizeof(header));
+    header[6] = 0x04;
+    memcpy(header + 7, "DiskDude!", 9);
+
+    // Old dumping tools signed bytes 7 to 15, which only makes the upper half of the mapper number unreliable
+    Cartridge cartridge = Cartridge(header, sizeof(header));
+    BOOST_CHECK_EQUAL(cartridge.is_valid_header(), true);
+    BOOST_CHECK_EQUAL(cartridge.has_trainer(), true);
+    BOOST_CHECK_EQUAL(cartridge.has_four_screen_mirroring(), false);
+    BOOST_CHECK_EQUAL(cartridge.get_mapper_number(), 0);
+    BOOST_CHECK_EQUAL(cartridge.get_rom_size(), 16 + TRAINER_SIZE + 8 * PRG_ROM_BANK_SIZE);
+}
+
+// Runs the PPU of both buses to the end of the next frame and checks they drew the same picture
+static bool same_next_frame(Bus& cached, Bus& redrawn) {
+    for (Bus* bus : {&cached, &redrawn}) {
+        uint64_t frame_number = bus->get_ppu()->get_frame_number();
+
+        while (bus->get_ppu()->get_frame_number() == frame_number) {
+            bus->get_ppu()->step(DOTS_PER_SCANLINE);
+        }
+    }
+
+    return memcmp(cached.get_ppu()->get_frame_buffer()->get_latest(), redrawn.get_ppu()->get_frame_buffer()->get_latest(),
+                  SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t)) == 0;
+}
+
+// The same random name table, attribute, pattern, palette and $2000/$2001 writes go to both buses, one of them
+// redraws the whole background every frame. Returns the first frame that differs, or -1.
+static int compare_background_cache(Cartridge* cartridge) {
+    Bus cached = Bus();
+    Bus redrawn = Bus();
+
+    if (cartridge) {
+        cached.attach_cartridge(cartridge);
+        redrawn.attach_cartridge(cartridge);
+    }
+
+    std::mt19937 random(26);
+
+    for (int frame = 0; frame < 2000; frame++) {
+        int nr_of_writes = random() % 64;
+
+        for (int i = 0; i < nr_of_writes; i++) {
+            uint16_t address;
+            uint8_t value = random();
+
+            switch (random() % 8) {
+                case 0:
+                case 1:
+                    address = random() % PATTERN_TABLE_TOP;
+                    break;
+                case 2:
+                    // Attribute tables
+                    address = NAME_TABLE_BOTTOM + (random() % 4) * NAME_TABLE_SIZE + ATTRIBUTE_TABLE_OFFSET + random() % 64;
+                    break;
+                case 3:
+                    address = IMAGE_PALETTE_BOTTOM + random() % 32;
+                    break;
+                case 4: {
+                    // Picks the name table and both pattern tables, but leaves NMIs off
+                    uint8_t control = value & 0x7F;
+                    cached.get_ppu()->write_register(CONTROL_REGISTER_1, control);
+                    redrawn.get_ppu()->write_register(CONTROL_REGISTER_1, control);
+                    continue;
+                }
+                case 5: {
+                    // Mostly with the background on, otherwise there's nothing to compare
+                    uint8_t mask = (random() % 8) ? (value | 0x08) : value;
+                    cached.get_ppu()->write_register(CONTROL_REGISTER_2, mask);
+                    redrawn.get_ppu()->write_register(CONTROL_REGISTER_2, mask);
+                    continue;
+                }
+                default:
+                    // Name tables, including the $3000 mirror
+                    address = ((random() % 8) ? NAME_TABLE_BOTTOM : 0x3000) + random() % (4 * NAME_TABLE_SIZE - 0x100);
+                    break;
+            }
+
+            cached.write_to_ppu(address, value);
+            redrawn.write_to_ppu(address, value);
+        }
+
+        redrawn.get_ppu()->invalidate_background();
+
+        if (!same_next_frame(cached, redrawn)) {
+            return frame;
+        }
+    }
+
+    return -1;
+}
+
+BOOST_AUTO_TEST_CASE(background_cache_test) {
+    // Only redrawing the tiles that were written to has to give the same frames as redrawing all of them
+    BOOST_CHECK_EQUAL(compare_background_cache(nullptr), -1);
+
+    // With mirroring half of the name table writes land in the other table, which the cache may be showing
+    uint8_t header[16];
+    memcpy(header, zelda_header, sizeof(header));
+
+    header[6] = 0x01;
+    Cartridge vertical = Cartridge(header, sizeof(header));
+    BOOST_REQUIRE(vertical.get_mirror_type());
+    BOOST_CHECK_EQUAL(compare_background_cache(&vertical), -1);
+
+    header[6] = 0x00;
+    Cartridge horizontal = Cartridge(header, sizeof(header));
+    BOOST_REQUIRE(!horizontal.get_mirror_type());
+    BOOST_CHECK_EQUAL(compare_background_cache(&horizontal), -1);
+}
+
+BOOST_AUTO_TEST_CASE(disassembler_test) {
+    // One instruction per addressing mode
+    const struct {
+        uint8_t bytes[3];
+        uint8_t length;
+        const char* text;
+    } instructions[] = {
+        {{0xEA}, 1, "NOP"},
+        {{0x0A}, 1, "ASL A"},
+        {{0xA9, 0x7F}, 2, "LDA #$7F"},
+        {{0xA5, 0x10}, 2, "LDA $10"},
+        {{0xB5, 0x10}, 2, "LDA $10,X"},
+        {{0xB6, 0x10}, 2, "LDX $10,Y"},
+        {{0xAD, 0x00, 0x03}, 3, "LDA $0300"},
+        {{0xBD, 0x00, 0x03}, 3, "LDA $0300,X"},
+        {{0xB9, 0x00, 0x03}, 3, "LDA $0300,Y"},
+        {{0x6C, 0xFC, 0xFF}, 3, "JMP ($FFFC)"},
+        {{0xA1, 0x20}, 2, "LDA ($20,X)"},
+        {{0xB1, 0x20}, 2, "LDA ($20),Y"},
+        {{0xD0, 0xFE}, 2, "BNE $8000"},
+        {{0x02}, 1, ".byte $02"},
+    };
+
+    for (const auto& instruction : instructions) {
+        BOOST_CHECK_EQUAL(get_instruction_length(instruction.bytes[0]), instruction.length);
+        BOOST_CHECK_EQUAL(disassemble_instruction(instruction.bytes, 0x8000), instruction.text);
+    }
+
+    // A one byte instruction at the very end of a buffer
+    std::vector<uint8_t> last = {0xEA};
+    BOOST_CHECK_EQUAL(disassemble_instruction(last.data(), 0xBFFF), "NOP");
+
+    // Branches across a page and around the end of the address space
+    const uint8_t branch[] = {0xD0, 0x20};
+    uint16_t target;
+    BOOST_CHECK_EQUAL(get_jump_target(branch, 0x80F0, target), true);
+    BOOST_CHECK_EQUAL(target, 0x8112);
+    BOOST_CHECK_EQUAL(get_jump_target(branch, 0xFFF0, target), true);
+    BOOST_CHECK_EQUAL(target, 0x0012);
+
+    const uint8_t jsr[] = {0x20, 0x34, 0x12};
+    BOOST_CHECK_EQUAL(get_jump_target(jsr, 0x8000, target), true);
+    BOOST_CHECK_EQUAL(target, 0x1234);
+    BOOST_CHECK_EQUAL(disassemble_instruction(jsr, 0x8000, "init"), "JSR init");
+    BOOST_CHECK_EQUAL(get_jump_target(instructions[9].bytes, 0x8000, target), false);
+}
+
+BOOST_AUTO_TEST_CASE(code_data_logger_test) {
+    CodeDataLogger logger = CodeDataLogger(4 * CDL_WINDOW_SIZE);
+    logger.map_window(0, 2);
+    logger.map_window(1, 3);
+
+    logger.log(0x8005, CDL_OPCODE);
+    logger.log(0xC010, CDL_DATA);
+    logger.log(0xC010, CDL_OPERAND);
+    logger.log(0x6000, CDL_DATA); // Not PRG-ROM
+
+    BOOST_CHECK_EQUAL(logger.get_flags()[2 * CDL_WINDOW_SIZE + 5], CDL_OPCODE);
+    BOOST_CHECK_EQUAL(logger.get_flags()[3 * CDL_WINDOW_SIZE + 0x10], CDL_DATA | CDL_OPERAND);
+    BOOST_CHECK_EQUAL(logger.count(CDL_OPCODE | CDL_DATA | CDL_OPERAND), 2);
+
+    // Switching banks moves where the same address lands
+    logger.map_window(0, 0);
+    logger.log(0x8005, CDL_DATA);
+    BOOST_CHECK_EQUAL(logger.get_flags()[5], CDL_DATA);
+    BOOST_CHECK_EQUAL(logger.count(CDL_DATA), 2);
+}
+
+BOOST_AUTO_TEST_CASE(nes2_header_test) {
+    // Mapper 0x104 submapper 3, 0x102 PRG-ROM banks, 4 CHR-ROM banks, 8 KB PRG-RAM, 32 KB battery backed PRG-RAM
+    const uint8_t header[16] = {'N', 'E', 'S', 0x1A, 0x02, 0x04, 0x43, 0x08, 0x31, 0x01, 0x97, 0x00, 0, 0, 0, 0};
+
+    Cartridge cartridge = Cartridge(header, sizeof(header));
+    BOOST_CHECK_EQUAL(cartridge.is_valid_header(), true);
+    BOOST_CHECK_EQUAL(cartridge.is_nes2(), true);
+    BOOST_CHECK_EQUAL(cartridge.get_mapper_number(), 0x104);
+    BOOST_CHECK_EQUAL(cartridge.get_submapper(), 3);
+    BOOST_CHECK_EQUAL(cartridge.get_nr_prg_rom_banks(), 0x102);
+    BOOST_CHECK_EQUAL(cartridge.get_nr_chr_rom_banks(), 4);
+    BOOST_CHECK_EQUAL(cartridge.get_prg_ram_size(), 0x2000);
+    BOOST_CHECK_EQUAL(cartridge.get_prg_nvram_size(), 0x8000);
+    BOOST_CHECK_EQUAL(cartridge.get_chr_ram_size(), 0);
+    BOOST_CHECK_EQUAL(cartridge.get_mirror_type(), true);
+    BOOST_CHECK_EQUAL(cartridge.has_battery_backed_ram(), true);
+    BOOST_CHECK_EQUAL(cartridge.get_nr_ram_banks(), 5);
+
+    // The largest PRG-RAM and PRG-NVRAM, 2 MB each
+    uint8_t large_ram_header[16];
+    memcpy(large_ram_header, header, sizeof(header));
+    large_ram_header[10] = 0xFF;
+
+    Cartridge large_ram_cartridge = Cartridge(large_ram_header, sizeof(large_ram_header));
+    BOOST_CHECK_EQUAL(large_ram_cartridge.get_nr_ram_banks(), 512);
+
+    // Exponent-multiplier notation: 2^16 * 3 bytes of PRG-ROM
+    uint8_t exponent_header[16];
+    memcpy(exponent_header, header, sizeof(header));
+    exponent_header[4] = (16 << 2) | 1;
+    exponent_header[9] = 0x0F;
+
+    Cartridge exponent_cartridge = Cartridge(exponent_header, sizeof(exponent_header));
+    BOOST_CHECK_EQUAL(exponent_cartridge.get_nr_prg_rom_banks(), 12);
+}
+
+BOOST_AUTO_TEST_CASE(crc32_test) {
+    BOOST_CHECK_EQUAL(crc32("123456789", 9), 0xCBF43926);
+
+    // Hashing in pieces of every size gives the same result as all at once
+    std::vector<uint8_t> data(100000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i * 7 + (i >> 8);
+    }
+
+    uint32_t crc = 0;
+    size_t offset = 0;
+    for (size_t length = 1; offset < data.size(); length = length * 2 + 1) {
+        length = std::min(length, data.size() - offset);
+        crc = crc32(data.data() + offset, length, crc);
+        offset += length;
+    }
+
+    BOOST_CHECK_EQUAL(crc, crc32(data.data(), data.size()));
+}
+
+BOOST_AUTO_TEST_CASE(rom_database_test) {
+    // The Zelda header says mapper 2, the database knows better
+    std::vector<uint8_t> rom(zelda_header, zelda_header + sizeof(zelda_header));
+    rom.resize(16 + 8 * PRG_ROM_BANK_SIZE, 0xEA);
+    uint32_t crc = crc32(rom.data() + 16, rom.size() - 16);
+
+    RomDatabase database;
+    database.add({crc + 1, 4, 0, HorizontalMirroring, false, 0x2000, 0, 0});
+    database.add({crc, 1, 0, HorizontalMirroring, true, 0, 0x2000, 0x2000});
+    database.add({crc - 1, 2, 0, VerticalMirroring, false, 0, 0, 0});
+    BOOST_CHECK_EQUAL(database.save("rom_database_test.db"), true);
+
+    RomDatabase loaded;
+    BOOST_CHECK_EQUAL(loaded.load("rom_database_test.db"), true);
+    BOOST_CHECK_EQUAL(loaded.get_size(), 3);
+
+    NES nes = NES();
+    nes.set_rom_database(&loaded);
+    BOOST_CHECK_EQUAL(nes.load_rom(rom.data(), rom.size()), true);
+    BOOST_CHECK_EQUAL(nes.get_rom_crc(), crc);
+
+    RomDatabaseEntry entry;
+    BOOST_CHECK_EQUAL(loaded.find(crc, entry), true);
+    BOOST_CHECK_EQUAL(entry.mapper_number, 1);
+    BOOST_CHECK_EQUAL(entry.prg_nvram_size, 0x2000);
+    BOOST_CHECK_EQUAL(loaded.find(crc + 2, entry), false);
+
+    Cartridge cartridge = Cartridge(rom.data(), rom.size());
+    cartridge.apply_database_entry(entry);
+    BOOST_CHECK_EQUAL(cartridge.get_mapper_number(), 1);
+    BOOST_CHECK_EQUAL(cartridge.has_four_screen_mirroring(), false);
+    BOOST_CHECK_EQUAL(cartridge.has_battery_backed_ram(), true);
+}
+
+BOOST_AUTO_TEST_CASE(rom_index_test) {
+    RomIndexEntry zelda = {"roms/zelda.nes", RomValid, false, true, true, 0x3FE272FB, 1, 0, HorizontalMirroring, 8, 0, 0, 0x2000, 0x2000, 131088, 1234567890123456789};
+    RomIndexEntry broken = {};
+    broken.path = "roms/broken.nes";
+    broken.status = RomTruncated;
+    broken.file_size = 100;
+
+    RomIndex index;
+    index.set_entries({zelda, broken});
+    BOOST_CHECK_EQUAL(index.save("rom_index_test.idx"), true);
+
+    RomIndex loaded;
+    BOOST_CHECK_EQUAL(loaded.load("rom_index_test.idx"), true);
+    BOOST_CHECK_EQUAL(loaded.get_entries().size(), 2);
+    BOOST_CHECK_EQUAL(loaded.get_entries()[0].path, "roms/broken.nes");
+    BOOST_CHECK(loaded.find("roms/missing.nes") == nullptr);
+
+    const RomIndexEntry* entry = loaded.find("roms/zelda.nes");
+    BOOST_REQUIRE(entry != nullptr);
+    BOOST_CHECK_EQUAL(entry->crc, zelda.crc);
+    BOOST_CHECK_EQUAL(entry->battery_backed_ram, true);
+    BOOST_CHECK_EQUAL(entry->from_database, true);
+    BOOST_CHECK_EQUAL(entry->nr_prg_rom_banks, 8);
+    BOOST_CHECK_EQUAL(entry->prg_nvram_size, 0x2000);
+    BOOST_CHECK_EQUAL(entry->modification_time, zelda.modification_time);
+    BOOST_CHECK_EQUAL(loaded.find("roms/broken.nes")->status, RomTruncated);
+}
+
+#endif
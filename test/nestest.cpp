@@ -0,0 +1,212 @@
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "../src/nes.h"
+
+#define NESTEST_START 0xC000 // Automation mode, runs every test without needing a PPU or controller
+#define NESTEST_START_SP 0xFD
+#define NESTEST_START_P 0x24
+#define NESTEST_START_CYCLES 7
+#define CONTEXT_LINES 6 // Lines of the log shown before the divergence
+
+// CPU state on one line of the log, or of our own run
+struct TraceState {
+    uint16_t PC;
+    uint8_t A;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t P;
+    uint8_t SP;
+    uint64_t cycles;
+};
+
+// The CPU stores the status bits in reverse order, the log uses the hardware layout
+static uint8_t to_hardware_flags(uint8_t P) {
+    uint8_t flags = 0;
+
+    for (int i = 0; i < 8; i++) {
+        flags |= ((P >> i) & 1) << (7 - i);
+    }
+
+    // The unused bit always reads as set and the break flag only exists on the stack
+    return (flags | 0x20) & ~0x10;
+}
+
+static bool operator==(const TraceState& a, const TraceState& b) {
+    return a.PC == b.PC && a.A == b.A && a.X == b.X && a.Y == b.Y && a.P == b.P && a.SP == b.SP && a.cycles == b.cycles;
+}
+
+static bool parse_field(const char* line, const char* line_end, const char* name, int base, uint64_t& value) {
+    const char* field = std::search(line, line_end, name, name + strlen(name));
+
+    if (field == line_end) {
+        return false;
+    }
+
+    value = strtoull(field + strlen(name), nullptr, base);
+    return true;
+}
+
+// Lines look like "C000  4C F5 C5  JMP $C5F5   A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7",
+// only the fields are looked up so the disassembly column doesn't matter
+static bool parse_line(const char* line, const char* line_end, TraceState& state) {
+    uint64_t PC, A, X, Y, P, SP, cycles;
+
+    if (line_end - line < 4) {
+        return false;
+    }
+
+    PC = strtoull(std::string(line, 4).c_str(), nullptr, 16);
+
+    if (!parse_field(line, line_end, " A:", 16, A) || !parse_field(line, line_end, " X:", 16, X) ||
+        !parse_field(line, line_end, " Y:", 16, Y) || !parse_field(line, line_end, " P:", 16, P) ||
+        !parse_field(line, line_end, " SP:", 16, SP) || !parse_field(line, line_end, "CYC:", 10, cycles)) {
+        return false;
+    }
+
+    state = {(uint16_t) PC, (uint8_t) A, (uint8_t) X, (uint8_t) Y, (uint8_t) P, (uint8_t) SP, cycles};
+    return true;
+}
+
+static std::string format_state(const TraceState& state) {
+    std::stringstream line;
+    line << std::hex << std::uppercase << std::setfill('0')
+         << std::setw(4) << state.PC
+         << " A:" << std::setw(2) << (int) state.A
+         << " X:" << std::setw(2) << (int) state.X
+         << " Y:" << std::setw(2) << (int) state.Y
+         << " P:" << std::setw(2) << (int) state.P
+         << " SP:" << std::setw(2) << (int) state.SP
+         << std::dec << " CYC:" << state.cycles;
+    return line.str();
+}
+
+// Runs nestest.nes from $C000 and compares the CPU state before every instruction against the reference log
+int main(int argc, char **argv) {
+    // Usage: nestest <nestest.nes> <nestest.log> [--ignore-cycles]
+    const char* rom_path = nullptr;
+    const char* log_path = nullptr;
+    bool ignore_cycles = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ignore-cycles") == 0) {
+            ignore_cycles = true;
+        } else if (!rom_path) {
+            rom_path = argv[i];
+        } else {
+            log_path = argv[i];
+        }
+    }
+
+    if (!rom_path || !log_path) {
+        std::cout << "Usage: " << argv[0] << " <nestest.nes> <nestest.log> [--ignore-cycles]" << std::endl;
+        return 2;
+    }
+
+    // Read the whole log at once, lines are only parsed as far as the run gets
+    std::ifstream log_file(log_path, std::ios::binary);
+    std::ifstream rom_file(rom_path, std::ios::binary);
+
+    if (!log_file || !rom_file) {
+        std::cout << "Could not open " << (log_file ? rom_path : log_path) << std::endl;
+        return 2;
+    }
+
+    std::string log((std::istreambuf_iterator<char>(log_file)), std::istreambuf_iterator<char>());
+
+    auto start = std::chrono::steady_clock::now();
+
+    NES* nes = new NES();
+    if (!nes->load_rom(rom_path)) {
+        delete nes;
+        return 2;
+    }
+    nes->set_audio_enabled(false);
+
+    CPUState cpu_state;
+    nes->save_cpu_state(cpu_state);
+    cpu_state.PC = NESTEST_START;
+    cpu_state.SP = NESTEST_START_SP;
+    cpu_state.P = NESTEST_START_P; // Symmetric, so the same in either bit order
+    cpu_state.cycles = NESTEST_START_CYCLES;
+    nes->load_cpu_state(cpu_state);
+
+    // The last lines that matched, for the context window
+    std::string context[CONTEXT_LINES];
+    uint64_t line_number = 0;
+    size_t offset = 0;
+
+    while (offset < log.size()) {
+        size_t line_end = log.find('\n', offset);
+        if (line_end == std::string::npos) {
+            line_end = log.size();
+        }
+
+        const char* line = log.data() + offset;
+        size_t length = line_end - offset;
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+
+        TraceState expected;
+        if (!parse_line(line, line + length, expected)) {
+            // Skip blank or otherwise unparsable lines
+            offset = line_end + 1;
+            continue;
+        }
+
+        line_number++;
+
+        nes->save_cpu_state(cpu_state);
+        TraceState actual = {cpu_state.PC, cpu_state.A, cpu_state.X, cpu_state.Y, to_hardware_flags(cpu_state.P), cpu_state.SP, cpu_state.cycles};
+
+        if (ignore_cycles) {
+            actual.cycles = expected.cycles;
+        }
+
+        if (!(expected == actual)) {
+            std::cout << "Diverged from the log at line " << line_number << ":" << std::endl;
+
+            uint64_t shown = std::min<uint64_t>(line_number - 1, CONTEXT_LINES);
+            for (uint64_t i = line_number - 1 - shown; i < line_number - 1; i++) {
+                std::cout << "    " << context[i % CONTEXT_LINES] << std::endl;
+            }
+
+            std::cout << "expected: " << format_state(expected) << std::endl;
+            std::cout << "     got: " << format_state(actual) << std::endl;
+
+            // nestest leaves the number of the last failed test in $02 and $03
+            std::cout << "Result codes: $02=" << std::hex << std::uppercase << std::setfill('0')
+                      << std::setw(2) << (int) nes->read_from_cpu(0x02) << " $03="
+                      << std::setw(2) << (int) nes->read_from_cpu(0x03) << std::dec << std::endl;
+
+            delete nes;
+            return 1;
+        }
+
+        context[(line_number - 1) % CONTEXT_LINES].assign(line, length);
+        offset = line_end + 1;
+
+        nes->execute_next_instruction();
+    }
+
+    if (line_number == 0) {
+        std::cout << "No CPU states found in " << log_path << std::endl;
+        delete nes;
+        return 2;
+    }
+
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "All " << line_number << " instructions match the log (" << elapsed << " ms)" << std::endl;
+
+    delete nes;
+    return 0;
+}
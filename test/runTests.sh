@@ -1,2 +1,2 @@
-g++ -o ines_header_test -lboost_unit_test_framework ines_header_test.cpp ../src/nes.cpp
-./ines_header_test
\ No newline at end of file
+cmake -S .. -B ../build && cmake --build ../build --target ines_header_test
+ctest --test-dir ../build --output-on-failure
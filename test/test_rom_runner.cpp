@@ -0,0 +1,335 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "../src/nes.h"
+#include "../src/hash.h"
+#include "../src/instrumentation.h"
+#include "../src/rom_batch.h"
+
+#define DEFAULT_MAX_FRAMES 3600 // A minute of emulated time
+#define RESET_DELAY_FRAMES 6 // The $6000 protocol wants the reset pressed at least 100 ms after it asks for one
+
+// blargg's test ROMs report through $6000: a status byte, a signature and a zero-terminated message
+#define STATUS_ADDRESS 0x6000
+#define SIGNATURE_ADDRESS 0x6001
+#define MESSAGE_ADDRESS 0x6004
+#define MESSAGE_MAX_LENGTH 0x1000
+#define STATUS_RUNNING 0x80
+#define STATUS_NEEDS_RESET 0x81
+
+enum TestStatus { Passed, Failed, TimedOut, LoadError };
+
+struct TestResult {
+    std::string rom_path;
+    TestStatus status;
+    int code; // Result code written to $6000, -1 when the ROM doesn't use the protocol
+    std::string message;
+    uint64_t frames;
+    double seconds;
+};
+
+static const char* status_names[] = {"passed", "failed", "timed out", "error"};
+
+// ROMs that only show their result on screen come with a <rom>.hash file holding the hash of the passing frame
+static bool read_expected_hash(const std::string& rom_path, uint64_t& hash) {
+    std::ifstream input(rom_path + ".hash");
+
+    if (!(input >> std::hex >> hash)) {
+        return false;
+    }
+
+    return true;
+}
+
+static std::string read_message(NES* nes) {
+    std::string message;
+
+    for (uint16_t address = MESSAGE_ADDRESS; address < MESSAGE_ADDRESS + MESSAGE_MAX_LENGTH; address++) {
+        uint8_t c = nes->read_from_cpu(address);
+        if (c == 0) {
+            break;
+        }
+        message += (char) c;
+    }
+
+    // Trim the trailing newlines the ROMs like to print
+    while (!message.empty() && (message.back() == '\n' || message.back() == ' ')) {
+        message.pop_back();
+    }
+
+    return message;
+}
+
+static TestResult run_test(const std::string& rom_path, uint64_t max_frames) {
+    TestResult result = {rom_path, TimedOut, -1, "", 0, 0};
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t expected_hash;
+    bool has_expected_hash = read_expected_hash(rom_path, expected_hash);
+    uint64_t last_hash = 0;
+
+    NES* nes = new NES();
+
+    if (!nes->load_rom(rom_path.c_str())) {
+        result.status = LoadError;
+        result.message = "Could not load the ROM";
+        delete nes;
+        return result;
+    }
+
+    nes->set_audio_enabled(false);
+    nes->reset(); // Start from the reset vector like the hardware does
+
+    uint64_t reset_frame = 0; // Frame at which a requested reset is pressed, 0 when none is pending
+    bool reset_handled = false;
+
+    for (result.frames = 1; result.frames <= max_frames; result.frames++) {
+        nes->run_frame();
+
+        bool has_signature = nes->read_from_cpu(SIGNATURE_ADDRESS) == 0xDE && nes->read_from_cpu(SIGNATURE_ADDRESS + 1) == 0xB0 &&
+                             nes->read_from_cpu(SIGNATURE_ADDRESS + 2) == 0x61;
+
+        if (has_signature) {
+            uint8_t status = nes->read_from_cpu(STATUS_ADDRESS);
+
+            if (status == STATUS_NEEDS_RESET) {
+                if (!reset_handled && reset_frame == 0) {
+                    reset_frame = result.frames + RESET_DELAY_FRAMES;
+                } else if (reset_frame == result.frames) {
+                    nes->reset();
+                    reset_frame = 0;
+                    reset_handled = true;
+                }
+                continue;
+            }
+
+            reset_handled = false;
+
+            if (status < STATUS_RUNNING) {
+                result.code = status;
+                result.status = status == 0 ? Passed : Failed;
+                result.message = read_message(nes);
+                break;
+            }
+        } else if (has_expected_hash) {
+            TripleBuffer* frames = nes->get_frame_buffer();
+            last_hash = hash64(frames->get_latest(), frames->get_size() * sizeof(uint32_t));
+
+            if (last_hash == expected_hash) {
+                result.status = Passed;
+                break;
+            }
+        }
+    }
+
+    if (result.status == TimedOut) {
+        result.frames = max_frames;
+
+        std::stringstream message;
+        message << "No result after " << max_frames << " frames";
+        if (has_expected_hash) {
+            message << ", last frame hash " << std::hex << std::setw(16) << std::setfill('0') << last_hash;
+        }
+        result.message = message.str();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    delete nes;
+    return result;
+}
+
+static std::string json_escape(const std::string& text) {
+    std::stringstream escaped;
+
+    for (char c : text) {
+        switch (c) {
+            case '"': { escaped << "\\\""; break; }
+            case '\\': { escaped << "\\\\"; break; }
+            case '\n': { escaped << "\\n"; break; }
+            default: {
+                if ((uint8_t) c < 0x20) {
+                    escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) c << std::dec;
+                } else {
+                    escaped << c;
+                }
+            }
+        }
+    }
+
+    return escaped.str();
+}
+
+static std::string xml_escape(const std::string& text) {
+    std::string escaped;
+
+    for (char c : text) {
+        switch (c) {
+            case '&': { escaped += "&amp;"; break; }
+            case '<': { escaped += "&lt;"; break; }
+            case '>': { escaped += "&gt;"; break; }
+            case '"': { escaped += "&quot;"; break; }
+            default: {
+                // Control characters other than whitespace aren't allowed in XML 1.0
+                if ((uint8_t) c >= 0x20 || c == '\n' || c == '\t') {
+                    escaped += c;
+                }
+            }
+        }
+    }
+
+    return escaped;
+}
+
+static void write_json_report(const char* path, const std::vector<TestResult>& results, double seconds) {
+    std::ofstream output(path);
+    size_t passed = std::count_if(results.begin(), results.end(), [](const TestResult& r) { return r.status == Passed; });
+
+    output << "{\n  \"tests\": " << results.size() << ",\n  \"passed\": " << passed
+           << ",\n  \"failed\": " << results.size() - passed << ",\n  \"seconds\": " << seconds << ",\n  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const TestResult& result = results[i];
+        output << "    {\"rom\": \"" << json_escape(result.rom_path) << "\", \"status\": \"" << status_names[result.status]
+               << "\", \"code\": " << result.code << ", \"message\": \"" << json_escape(result.message)
+               << "\", \"frames\": " << result.frames << ", \"seconds\": " << result.seconds << "}"
+               << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    output << "  ]\n}\n";
+}
+
+static void write_junit_report(const char* path, const std::vector<TestResult>& results, double seconds) {
+    std::ofstream output(path);
+    size_t errors = std::count_if(results.begin(), results.end(), [](const TestResult& r) { return r.status == LoadError; });
+    size_t failures = std::count_if(results.begin(), results.end(), [](const TestResult& r) { return r.status == Failed || r.status == TimedOut; });
+
+    output << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           << "<testsuite name=\"test-roms\" tests=\"" << results.size() << "\" failures=\"" << failures
+           << "\" errors=\"" << errors << "\" time=\"" << seconds << "\">\n";
+
+    for (const TestResult& result : results) {
+        std::filesystem::path rom(result.rom_path);
+        output << "  <testcase classname=\"" << xml_escape(rom.parent_path().string()) << "\" name=\""
+               << xml_escape(rom.filename().string()) << "\" time=\"" << result.seconds << "\"";
+
+        if (result.status == Passed) {
+            output << "/>\n";
+            continue;
+        }
+
+        const char* element = result.status == LoadError ? "error" : "failure";
+        output << ">\n    <" << element << " message=\"" << status_names[result.status];
+        if (result.code >= 0) {
+            output << " with code " << result.code;
+        }
+        output << "\">" << xml_escape(result.message) << "</" << element << ">\n  </testcase>\n";
+    }
+
+    output << "</testsuite>\n";
+}
+
+// Runs a directory of test ROMs in parallel, each in its own NES, and reports which ones passed
+int main(int argc, char **argv) {
+    // Usage: test_rom_runner <directory or rom>... [--jobs n] [--frames n] [--json path] [--junit path] [--zones path] [--verbose]
+    std::vector<std::string> inputs;
+    unsigned int nr_of_jobs = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t max_frames = DEFAULT_MAX_FRAMES;
+    const char* json_path = nullptr;
+    const char* junit_path = nullptr;
+    const char* zones_path = nullptr;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            nr_of_jobs = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            max_frames = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--junit") == 0 && i + 1 < argc) {
+            junit_path = argv[++i];
+        } else if (strcmp(argv[i], "--zones") == 0 && i + 1 < argc) {
+            // How the ROMs were spread over the workers, in builds with NES_INSTRUMENTATION
+            zones_path = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cout << "Usage: " << argv[0] << " <directory or rom>... [--jobs n] [--frames n] [--json path] [--junit path] [--zones path] [--verbose]" << std::endl;
+        return 2;
+    }
+
+    std::vector<std::string> rom_paths = collect_roms(inputs);
+
+    if (rom_paths.empty()) {
+        std::cout << "No ROMs found" << std::endl;
+        return 2;
+    }
+
+    std::vector<TestResult> results(rom_paths.size());
+
+    NullBuffer null_buffer;
+    std::streambuf* stdout_buffer = std::cout.rdbuf();
+    if (!verbose) {
+        std::cout.rdbuf(&null_buffer);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    unsigned int nr_of_threads = parallel_for_each(rom_paths.size(), nr_of_jobs, [&](size_t rom) {
+        ZONE("test rom");
+        results[rom] = run_test(rom_paths[rom], max_frames);
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.rdbuf(stdout_buffer);
+
+    size_t passed = 0;
+    for (const TestResult& result : results) {
+        if (result.status == Passed) {
+            passed++;
+            continue;
+        }
+
+        std::cout << status_names[result.status] << ": " << result.rom_path;
+        if (result.code >= 0) {
+            std::cout << " (code " << result.code << ")";
+        }
+        if (!result.message.empty()) {
+            std::cout << "\n    " << result.message;
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << passed << "/" << results.size() << " test ROMs passed in " << seconds << " s using " << nr_of_threads << " threads" << std::endl;
+
+    if (json_path) {
+        write_json_report(json_path, results, seconds);
+    }
+
+    if (junit_path) {
+        write_junit_report(junit_path, results, seconds);
+    }
+
+    if (zones_path) {
+        write_zone_trace(zones_path);
+    }
+
+    return passed == results.size() ? 0 : 1;
+}